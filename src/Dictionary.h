@@ -3,62 +3,158 @@
 #ifndef _DICTIONARY_H_
 #define _DICTIONARY_H_
 
-int8_t node::create(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize, node* aLeft, node* aRight) {
+// ==== ALLOCATION ===================================================================
+
+#if defined (ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
+#include <esp_heap_caps.h>
+#endif
+
+// Default policy: with _DICT_USE_PSRAM the regions in _DICT_PSRAM_REGIONS go to
+// PSRAM and the others to internal RAM; either falls back to the ordinary heap.
+static void* dictDefaultAlloc(size_t size, uint8_t region) {
+  void* p = NULL;
+#if defined (ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
+  if ( psramFound() ) {
+    if ( region & (_DICT_PSRAM_REGIONS) ) p = ps_malloc(size);
+    else p = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  }
+#else
+  (void) region;
+#endif
+  if (!p) p = malloc(size);
+  return p;
+}
+
+static void dictDefaultFree(void* p, uint8_t) {
+  free(p);
+}
+
+static const DictionaryAllocator dictDefaultAllocator = { dictDefaultAlloc, dictDefaultFree };
+static const DictionaryAllocator* dictAllocator = &dictDefaultAllocator;
+
+void* dictAlloc(size_t size, uint8_t region) {
+  return dictAllocator->alloc(size, region);
+}
+
+void dictFree(void* p, uint8_t region) {
+  if ( p ) dictAllocator->free(p, region);
+}
+
+void Dictionary::setAllocator(const DictionaryAllocator* a) {
+  dictAllocator = a ? a : &dictDefaultAllocator;
+}
 
-  size_t  vsize_final;
+
+// ==== NODE STRINGS =================================================================
+
+#ifdef _DICT_SLAB
+int8_t node::create(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize, uintNN_t aHash, NodeSlab* aSlab) {
+#else
+int8_t node::create(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize, uintNN_t aHash) {
+#endif
 
   // Initialize both buffer pointers up front. If an allocation fails below and
   // the caller deletes this node, operator delete frees keybuf/valbuf - so they
   // must never be left indeterminate.
+#ifdef _DICT_ARENA_OFFSETS
+  vref = 0;       // no buffer pointers: the bytes trail the node
+#else
   keybuf = NULL;
   valbuf = NULL;
+#endif
+#ifdef _DICT_TIERS
+  vhot = 0;       // new values start out cold
+#endif
 
   if ( aKeySize == 0 ) return NODEARRAY_ERR; // a key cannot be zero-length
   vsize = aValSize;
-  vsize_final = (vsize + _DICT_EXTRA) == 0 ? 1 : vsize + _DICT_EXTRA;
 
 
   uintNN_t ks = ( aKeySize < sizeof(uintNN_t) ? sizeof(uintNN_t) : aKeySize );
   ksize = aKeySize;
+#ifdef _DICT_SSO
+  bool keyHeap = aKeySize > _DICT_SSO_LEN;   // else the strings live in the node
+  bool valHeap = aValSize > _DICT_SSO_LEN;
+#endif
+
+#ifdef _DICT_NODE_BLOCK
+  // The buffers trail the node in its own block (see operator new and
+  // Dictionary::newNode), and any rounding slack at the end of the block is
+  // spare value capacity.
+#ifndef _DICT_ARENA_OFFSETS
+  keybuf = (char*)(this + 1);
+  valbuf = keybuf + ks + _DICT_EXTRA;
+#endif
+  size_t vc = blockSize(aKeySize, aValSize) - sizeof(node) - ks - _DICT_EXTRA - _DICT_EXTRA;
+  vcap = (_DICT_VAL_TYPE)(vc < _DICT_VALLEN ? vc : _DICT_VALLEN);
+#else
+  size_t vsize_final = (vsize + _DICT_EXTRA) == 0 ? 1 : vsize + _DICT_EXTRA;
 
   // Now we will try to allocate memory to both char arrays
-#if defined(ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
-  if (psramFound()) {
-    keybuf = (char*)ps_malloc(ks + _DICT_EXTRA);
-  }
+#ifdef _DICT_SSO
+  if (keyHeap) {
+#endif
+#ifdef _DICT_SLAB
+  keybuf = (char*)aSlab->alloc(ks + _DICT_EXTRA, DICT_MEM_KEY);
+#else
+  keybuf = (char*)dictAlloc(ks + _DICT_EXTRA, DICT_MEM_KEY);
 #endif
-  if (!keybuf)
-    keybuf = (char*)malloc(ks + _DICT_EXTRA);
 
   if (!keybuf) return NODEARRAY_MEM;
-
-#if defined(ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
-  if (psramFound()) {
-    valbuf = (char*)ps_malloc(vsize_final);
+#ifdef _DICT_SSO
   }
+  if (valHeap) {
+#endif
+
+#ifdef _DICT_SLAB
+  valbuf = (char*)aSlab->alloc(vsize_final, DICT_MEM_VALUE);
+#else
+  valbuf = (char*)dictAlloc(vsize_final, DICT_MEM_VALUE);
 #endif
-  if (!valbuf)
-    valbuf = (char*)malloc(vsize_final);
 
   if (!valbuf) {
-    free(keybuf);
+#if defined(_DICT_SSO)
+    if (keyHeap) dictFree(keybuf, DICT_MEM_KEY);
+#elif defined(_DICT_SLAB)
+    aSlab->release(keybuf, ks + _DICT_EXTRA, DICT_MEM_KEY);
+#else
+    dictFree(keybuf, DICT_MEM_KEY);
+#endif
     keybuf = NULL;
     return NODEARRAY_MEM;
   }
+#ifdef _DICT_SSO
+  }
+#endif
+#endif
 
   // Success - we have space for both strings
-  memset(keybuf, 0, ks);
-  memcpy(keybuf, aKey, aKeySize);
-  memcpy(valbuf, aVal, aValSize);
+#ifdef _DICT_SSO
+  if (keyHeap) memset(keybuf, 0, ks);
+#else
+  memset(kbuf(), 0, ks);
+#endif
+  memcpy(kbuf(), aKey, aKeySize);
+  memcpy(vbuf(), aVal, aValSize);
 #ifndef _DICT_COMPRESS
   // Keep buffers NUL-terminated at write time so that read operations
   // (search/key/value) never have to mutate the node to terminate a String.
-  keybuf[aKeySize] = 0;
-  valbuf[aValSize] = 0;
+  kbuf()[aKeySize] = 0;
+  vbuf()[aValSize] = 0;
 #endif
 
-  left = aLeft;
-  right = aRight;
+#ifdef _DICT_ENGINE_TREE
+  left = NULL;
+  right = NULL;
+  hkey = aHash;
+#ifdef _DICT_BALANCED
+  height = 1;
+#endif
+#endif
+#ifdef _DICT_TIERS
+  hits = 0;
+#endif
+  (void) aHash;
 
 #ifdef _LIBDEBUG_
   Serial.print("NODE-CREATE: created a node:\n");
@@ -69,46 +165,113 @@ int8_t node::create(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal,
 }
 
 
+#if defined(_DICT_SLAB)
+int8_t node::updateValue(const char* aVal, _DICT_VAL_TYPE aValSize, NodeSlab* aSlab) {
+#elif defined(_DICT_ARENA)
+int8_t node::updateValue(const char* aVal, _DICT_VAL_TYPE aValSize, NodeArena* aArena) {
+#else
 int8_t node::updateValue(const char* aVal, _DICT_VAL_TYPE aValSize) {
+#endif
   if ( aValSize > _DICT_VALLEN ) return NODEARRAY_ERR;
   
+#if defined(_DICT_SINGLE_ALLOC) || defined(_DICT_ARENA)
+  if (aValSize <= vcap) { // fits into the block (or the bytes it has moved to) - will just update
+#elif defined(_DICT_SSO)
+  // Inline to inline, or into a heap buffer that is big enough - will just update
+  if (aValSize <= _DICT_SSO_LEN ? vsize <= _DICT_SSO_LEN : (vsize > _DICT_SSO_LEN && aValSize <= vsize)) {
+#elif defined(_DICT_SLAB)
+  // Same size class, or a long (unclassed) string getting shorter - will just update
+  size_t have = NodeSlab::capacity(vsize + _DICT_EXTRA);
+  size_t need = aValSize + _DICT_EXTRA;
+  if (NodeSlab::capacity(need) == have || (need > NodeSlab::LARGEST && need <= have)) {
+#else
   if (aValSize <= vsize) { // new string fits into the old one - will just update
-    memcpy(valbuf, aVal, aValSize);
+#endif
+    memcpy(vbuf(), aVal, aValSize);
     vsize = aValSize;
 #ifndef _DICT_COMPRESS
-    valbuf[aValSize] = 0;
+    vbuf()[aValSize] = 0;
 #endif
 
 #ifdef _LIBDEBUG_
-    Serial.printf("NODE-UPDATEVALUE: updated value for key = %d\n", (uint32_t)keybuf);
+    Serial.printf("NODE-UPDATEVALUE: updated value for key = %d\n", (uint32_t)kbuf());
     printNode();
 #endif
 
     return NODEARRAY_OK;
   }
 
-  char* temp = NULL;
-#if defined(ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
-  if (psramFound()) {
-    temp = (char*)ps_malloc(aValSize + _DICT_EXTRA);
+#ifdef _DICT_SINGLE_ALLOC
+  return NODEARRAY_MEM;     // the node has to move: see resized()
+}
+
+
+node* node::resized(const char* aVal, _DICT_VAL_TYPE aValSize) {
+  node* n = new (ksize, aValSize) node;
+  if (!n) return NULL;
+  if (n->create(keybuf, ksize, aVal, aValSize, key()) != NODEARRAY_OK) {
+    delete n;
+    return NULL;
   }
+#ifdef _DICT_ENGINE_TREE
+  n->left = left;
+  n->right = right;
+#ifdef _DICT_BALANCED
+  n->height = height;
+#endif
+#endif
+  return n;
+}
+
+#else
+  char* temp = NULL;
+#ifdef _DICT_SSO
+  if (aValSize > _DICT_SSO_LEN) {     // else the value moves into the node
+#endif
+#if defined(_DICT_SLAB)
+  temp = (char*)aSlab->alloc(need, DICT_MEM_VALUE);
+#elif defined(_DICT_ARENA_OFFSETS)
+  _DICT_REF_TYPE ref;
+  temp = (char*)aArena->alloc(aValSize + _DICT_EXTRA, &ref);
+#elif defined(_DICT_ARENA)
+  temp = (char*)aArena->alloc(aValSize + _DICT_EXTRA);
+#else
+  temp = (char*)dictAlloc(aValSize + _DICT_EXTRA, valRegion());   // the value keeps its tier
 #endif
-  if (!temp)
-    temp = (char*)malloc(aValSize + _DICT_EXTRA);
 
   if (!temp) { // no memory
     return NODEARRAY_MEM;
   }
+#ifdef _DICT_SSO
+  }
+#endif
 
   // ok - we have enough space for the new value, lets copy the string there and delete the old one.
 
-  if ( valbuf ) free(valbuf);
+#if defined(_DICT_SSO)
+  if ( vsize > _DICT_SSO_LEN ) dictFree(valbuf, valRegion());
+  if ( temp ) valbuf = temp;
+#elif defined(_DICT_ARENA)
+  // The old bytes stay with the arena; the new ones are rounded up too.
+#ifdef _DICT_ARENA_OFFSETS
+  vref = ref;
+#else
   valbuf = temp;
+#endif
+  size_t vc = ((aValSize + _DICT_EXTRA + _DICT_NODE_ALIGN - 1) & ~(size_t)(_DICT_NODE_ALIGN - 1)) - _DICT_EXTRA;
+  vcap = (_DICT_VAL_TYPE)(vc < _DICT_VALLEN ? vc : _DICT_VALLEN);
+#elif defined(_DICT_SLAB)
+  aSlab->release(valbuf, vsize + _DICT_EXTRA, DICT_MEM_VALUE);
+  valbuf = temp;
+#else
+  if ( valbuf ) dictFree(valbuf, valRegion());
+  valbuf = temp;
+#endif
 
   vsize = aValSize;
-  memcpy(valbuf, aVal, vsize);
+  memcpy(vbuf(), aVal, vsize);
 #ifndef _DICT_COMPRESS
-  valbuf[aValSize] = 0;
+  vbuf()[aValSize] = 0;
 #endif
 
 #ifdef _LIBDEBUG_
@@ -120,226 +283,231 @@ int8_t node::updateValue(const char* aVal, _DICT_VAL_TYPE aValSize) {
 }
 
 
-int8_t node::updateKey(const char* aKey, _DICT_KEY_TYPE aKeySize) {
-  if (aKeySize > _DICT_KEYLEN) return NODEARRAY_ERR;;
-
-  _DICT_KEY_TYPE ks = aKeySize < sizeof(uintNN_t) ? sizeof(uintNN_t) : aKeySize;
+#ifdef _DICT_TIERS
+int8_t node::moveValue(uint8_t aHot) {
+  size_t sz = valBytes();
+  if ( sz == 0 ) return NODEARRAY_OK;   // inline: no buffer to move
 
-  if (ks < ksize) { // new string fits into the old one - will just update
-    memcpy(keybuf, aKey, aKeySize);
-    ksize = aKeySize;
-#ifndef _DICT_COMPRESS
-    keybuf[aKeySize] = 0;
+  char* temp = (char*)dictAlloc(sz, aHot ? DICT_MEM_HOT : DICT_MEM_VALUE);
+  if ( !temp ) return NODEARRAY_MEM;    // the value stays where it is
+  memcpy(temp, valbuf, sz);
+  dictFree(valbuf, valRegion());
+  valbuf = temp;
+  vhot = aHot;
+  return NODEARRAY_OK;
+}
 #endif
+#endif // _DICT_SINGLE_ALLOC
+
 
 #ifdef _LIBDEBUG_
-    Serial.printf("NODE-UPDATEKEY: updated key = %d\n", (uint32_t)keybuf);
-    printNode();
+void node::printNode() {
+  Serial.println("node:");
+  Serial.printf("\tkeyNN   = %u\n", key());
+  Serial.printf("\tkey  = ");
+  for (int i=0; i<ksize; i++) Serial.printf("%02x", kbuf()[i]); 
+  Serial.printf(" (%d) (%u)\n", ksize, (uint32_t)kbuf());
+  Serial.printf("\tval  = ");
+  for (int i=0; i<vsize; i++) Serial.printf("%02x", vbuf()[i]); 
+  Serial.printf(" (%d) (%u)\n", vsize, (uint32_t)vbuf());
+#ifdef _DICT_ENGINE_TREE
+  Serial.printf("\tLeft n  = %u\n", (uint32_t)left);
+  Serial.printf("\tRight n = %u\n", (uint32_t)right);
 #endif
-
-    return NODEARRAY_OK;
-  }
-  
-  char* temp = NULL;
-#if defined(ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
-  if (psramFound()) {
-    temp = (char*)ps_malloc(ks + _DICT_EXTRA);
-  }
+}
 #endif
-  if (!temp)
-    temp = (char*)malloc(ks + _DICT_EXTRA);
 
-  if (!temp) { // no memory, will copy as much as we can, and return an error
 
-#ifdef _LIBDEBUG_
-    Serial.printf("NODE-UPDATEKEY: NOMEMORY replace keybuf = %d\n", (uint32_t)keybuf);
-    printNode();
-#endif
 
-    return NODEARRAY_MEM;
-  }
 
-  // ok - we have enough space for the new value, lets copy the string there and delete the old one.
+#ifdef _DICT_ORDERED
+// init the queue (constructor).
+NodeArray::NodeArray(size_t init_size) {
+  (void) init_size;   // the list has no capacity
+  head = tail = cur = NULL;
+  curIndex = 0;
+  items = 0;
+}
 
-  if ( keybuf ) free(keybuf);
-  keybuf = temp;
+// clear the queue (destructor). The nodes are freed by the dictionary.
+NodeArray::~NodeArray() {
+  head = tail = cur = NULL;
+  items = 0;
+}
 
-  ksize = aKeySize;
-  memcpy(keybuf, aKey, ksize);
-#ifndef _DICT_COMPRESS
-  keybuf[aKeySize] = 0;
-#endif
+// add an item to the queue.
+int8_t NodeArray::append(const node* i) {
+  if (items >= _DICT_MAX_PAIRS) return NODEARRAY_MEM;
+
+  node* n = (node*)i;
+  n->prev = tail;
+  n->next = NULL;
+  if (tail) tail->next = n;
+  else      head = n;
+  tail = n;
+  items++;
 
 #ifdef _LIBDEBUG_
-  Serial.printf("NODE-UPDATEKEY: replaced keybuf = %d\n", (uint32_t)keybuf);
-  printNode();
+  Serial.printf("NODEARRAY-APPEND: successfully added a node %x. Cur size: %d\n", (uint32_t) i, items);
 #endif
-
   return NODEARRAY_OK;
 }
 
+// remove an item from the queue; the items after it move up one position.
+void NodeArray::remove(const node* i) {
+#ifdef _LIBDEBUG_
+  Serial.printf("NODEARRAY-REMOVE: request remove: %u\n", (uint32_t)i);
+#endif
 
-// Atomically replace both the key and the value. Any buffer that needs to grow
-// is allocated up front; if any allocation fails the node is left completely
-// unchanged and NODEARRAY_MEM is returned. Used by deleteNode when promoting the
-// in-order successor, where a partial update would corrupt the tree.
-int8_t node::updateKeyValue(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize) {
-  if ( aKeySize == 0 ) return NODEARRAY_ERR;
-  if ( aKeySize > _DICT_KEYLEN ) return NODEARRAY_ERR;
-  if ( aValSize > _DICT_VALLEN ) return NODEARRAY_ERR;
-
-  _DICT_KEY_TYPE ks = ( aKeySize < sizeof(uintNN_t) ? sizeof(uintNN_t) : aKeySize );
-
-  // Whether the incoming key/value fit in the current buffers. These mirror the
-  // (conservative) reuse rules of updateKey/updateValue.
-  bool needKeyAlloc = !(ks < ksize);
-  bool needValAlloc = !(aValSize <= vsize);
+  if (isEmpty()) return;
 
-  char* newKey = NULL;
-  char* newVal = NULL;
+  node* n = (node*)i;
+  if (n->prev) n->prev->next = n->next;
+  else         head = n->next;
+  if (n->next) n->next->prev = n->prev;
+  else         tail = n->prev;
+  items--;
 
-  if ( needKeyAlloc ) {
-#if defined(ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
-    if (psramFound()) newKey = (char*)ps_malloc(ks + _DICT_EXTRA);
-#endif
-    if (!newKey) newKey = (char*)malloc(ks + _DICT_EXTRA);
-    if (!newKey) return NODEARRAY_MEM;
+  // Removing the node just read (as in remove(key(i))) leaves its successor at
+  // the same position; any other remove may shift the cursor, so drop it.
+  if (cur == n) {
+    if (n->next) cur = n->next;
+    else if (n->prev) { cur = n->prev; curIndex--; }
+    else cur = NULL;
   }
-
-  if ( needValAlloc ) {
-    size_t vsize_final = (aValSize + _DICT_EXTRA) == 0 ? 1 : aValSize + _DICT_EXTRA;
-#if defined(ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
-    if (psramFound()) newVal = (char*)ps_malloc(vsize_final);
+  else cur = NULL;
+  n->prev = n->next = NULL;
+#ifdef _LIBDEBUG_
+    Serial.printf("NODEARRAY-REMOVE: current count: %d\n", items);
 #endif
-    if (!newVal) newVal = (char*)malloc(vsize_final);
-    if (!newVal) {
-      if (newKey) free(newKey);   // roll back - node stays unchanged
-      return NODEARRAY_MEM;
-    }
-  }
+}
 
-  // Commit: past this point nothing can fail.
-  if ( needKeyAlloc ) {
-    if (keybuf) free(keybuf);
-    keybuf = newKey;
-  }
-  else {
-    memset(keybuf, 0, ks);
-  }
-  memcpy(keybuf, aKey, aKeySize);
-  ksize = aKeySize;
-#ifndef _DICT_COMPRESS
-  keybuf[aKeySize] = 0;
+#ifdef _DICT_SINGLE_ALLOC
+// put n in the place of item i (a node that moved to a new block).
+void NodeArray::replace(const node* i, const node* n) {
+  node* o = (node*)i;
+  node* m = (node*)n;
+  m->prev = o->prev;
+  m->next = o->next;
+  if (m->prev) m->prev->next = m;
+  else         head = m;
+  if (m->next) m->next->prev = m;
+  else         tail = m;
+  if (cur == o) cur = m;
+}
 #endif
 
-  if ( needValAlloc ) {
-    if (valbuf) free(valbuf);
-    valbuf = newVal;
+node* NodeArray::operator [] (const size_t i) {
+  if (i >= items) return NULL;
+
+  // Start from the nearest of the head, the tail and the cursor.
+  node*  p = head;
+  size_t at = 0;
+  size_t best = i;
+  if (items - 1 - i < best) { p = tail; at = items - 1; best = items - 1 - i; }
+  if (cur) {
+    size_t d = (i > curIndex) ? i - curIndex : curIndex - i;
+    if (d < best) { p = cur; at = curIndex; }
   }
-  memcpy(valbuf, aVal, aValSize);
-  vsize = aValSize;
-#ifndef _DICT_COMPRESS
-  valbuf[aValSize] = 0;
-#endif
+  for (; at < i; at++) p = p->next;
+  for (; at > i; at--) p = p->prev;
 
-  return NODEARRAY_OK;
+  cur = p;
+  curIndex = i;
+  return p;
 }
 
-
 #ifdef _LIBDEBUG_
-void node::printNode() {
-  Serial.println("node:");
-  Serial.printf("\tkeyNN   = %u\n", key());
-  Serial.printf("\tkey  = ");
-  for (int i=0; i<ksize; i++) Serial.printf("%02x", keybuf[i]); 
-  Serial.printf(" (%d) (%u)\n", ksize, (uint32_t)keybuf);
-  Serial.printf("\tval  = ");
-  for (int i=0; i<vsize; i++) Serial.printf("%02x", valbuf[i]); 
-  Serial.printf(" (%d) (%u)\n", vsize, (uint32_t)valbuf);
-  Serial.printf("\tLeft n  = %u\n", (uint32_t)left);
-  Serial.printf("\tRight n = %u\n", (uint32_t)right);
+void NodeArray::printArray() {
+  Serial.printf("\nNodeArray::printArray:\n");
+  size_t i = 0;
+  for (node* p = head; p; p = p->next) Serial.printf("%d: %u\n", i++, (uint32_t)p);
+  Serial.println();
 }
 #endif
 
+// check if the queue is empty.
+bool NodeArray::isEmpty() const {
+  return items == 0;
+}
 
+// check if the queue is full.
+bool NodeArray::isFull() const {
+  return items >= _DICT_MAX_PAIRS;
+}
 
+// get the number of items in the queue.
+size_t NodeArray::count() const {
+  return items;
+}
 
+#else
 // init the queue (constructor).
 NodeArray::NodeArray(size_t init_size) {
-  size = 0;       // set the size of queue to zero.
   items = 0;      // set the number of items of queue to zero.
-  tail = 0;       // set the tail of the queue to zero.
+  segs = 0;
+  dirSize = 0;
+  dir = NULL;
 
-  initialSize = init_size;
-  contents = NULL;
+  shift = segmentShift(init_size);
 
   // Let's not allocate memory in the constructor and delegate it to the
-  // resize method, that could return something.
+  // append method, that could return something.
+
+}
 
+// slots per segment: init_size rounded up to a power of two, 8 to 256.
+uint8_t NodeArray::segmentShift(size_t init_size) {
+  uint8_t s = 3;
+  while (s < 8 && ((size_t)1 << s) < init_size) s++;
+  return s;
 }
 
 // clear the queue (destructor).
 NodeArray::~NodeArray() {
-  free(contents); // deallocate the array of the queue.
-
-  contents = NULL; // set queue's array pointer to nowhere.
-
-  size = 0;        // set the size of queue to zero.
   items = 0;       // set the number of items of queue to zero.
-  tail = 0;        // set the tail of the queue to zero.
-}
+  trim();
+  if (segs) dictFree(dir[--segs], DICT_MEM_INDEX);  // the spare
+  dictFree(dir, DICT_MEM_INDEX);
 
-// resize the size of the queue.
-int8_t NodeArray::resize(const size_t s) {
-  // defensive issue.
-  if (s <= 0) return NODEARRAY_ERR;
-  //    exit ("QUEUE: error due to undesirable size for queue size.");
+  dir = NULL;      // set queue's array pointer to nowhere.
+  dirSize = 0;
+}
 
-  // allocate enough memory for the temporary array.
-  node** temp = NULL;
-#if defined(ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
-  if (psramFound()) {
-    temp = (node**)ps_malloc(sizeof(node*) * s);
+// free the segments past the one the items end in, and one spare.
+void NodeArray::trim() {
+  size_t used = (items + ((size_t)1 << shift) - 1) >> shift;
+  while (segs > used + 1) {
+    dictFree(dir[--segs], DICT_MEM_INDEX);
+    dir[segs] = NULL;
   }
-#endif
-  if (!temp)
-    temp = (node**)malloc(sizeof(node*) * s);
-
-  // if there is a memory allocation error.
-  if (temp == NULL) return NODEARRAY_MEM;
-  //    exit ("QUEUE: insufficient memory to initialize temporary queue.");
-
-  // copy the items from the old queue to the new one.
-  for (size_t i = 0; i < items; i++)
-    temp[i] = contents[i];
-
-  // deallocate the old array of the queue.
-  free(contents);
-
-  // copy the pointer of the new queue.
-  contents = temp;
-
-  // set the head and tail of the new queue.
-  tail = items;
-
-  // set the new size of the queue.
-  size = s;
-  return NODEARRAY_OK;
 }
 
 // add an item to the queue.
 int8_t NodeArray::append(const node* i) {
+  if (items >= _DICT_MAX_PAIRS) return NODEARRAY_MEM;
+
   // check if the queue is full.
   if (isFull()) {
-    // Geometric growth: doubling keeps N appends at O(N) total copies rather than
-    // the O(N^2) of growing by a fixed increment each time.
-    size_t newSize = (size == 0) ? (initialSize ? initialSize : 1) : size * 2;
-    int8_t rc = resize(newSize);
-    if (rc) return rc;
+    // A new segment; only the directory (a pointer per segment) is ever copied,
+    // doubling so that stays O(1) per append.
+    if (segs == dirSize) {
+      size_t newSize = dirSize ? dirSize * 2 : 4;
+      node*** temp = (node***)dictAlloc(sizeof(node**) * newSize, DICT_MEM_INDEX);
+      if (temp == NULL) return NODEARRAY_MEM;
+      for (size_t j = 0; j < segs; j++) temp[j] = dir[j];
+      dictFree(dir, DICT_MEM_INDEX);
+      dir = temp;
+      dirSize = newSize;
+    }
+    node** seg = (node**)dictAlloc(sizeof(node*) << shift, DICT_MEM_INDEX);
+    if (seg == NULL) return NODEARRAY_MEM;
+    dir[segs++] = seg;
   }
 
   // store the item to the array.
-  contents[tail++] = (node*)i;
+  at(items) = (node*)i;
+  ((node*)i)->slot = items;
 
   // increase the items.
   items++;
@@ -351,7 +519,7 @@ int8_t NodeArray::append(const node* i) {
 }
 
 
-// remove an item from the queue.
+// remove an item from the queue: the last item takes its place.
 void NodeArray::remove(const node* i) {
   // check if the queue is empty.
 
@@ -362,45 +530,36 @@ void NodeArray::remove(const node* i) {
   if (isEmpty()) return;
   //    exit ("QUEUE: can't pop item from queue: queue is empty.");
 
-  if (items > 1) {
-    int8_t found = 0;
-    size_t index = 0;
-
-    for (size_t j = 0; j < items; j++) {
-      if (i == contents[j]) {
-        index = j;
-        found = 1;
-        break;
-      }
-    }
-
-    if ( !found ) return;  // how?
-
-#ifdef _LIBDEBUG_
-    Serial.printf("NODEARRAY-REMOVE: found index: %d\n", index);
-#endif
+  size_t index = i->slot;
+  if (index >= items || at(index) != i) return;  // how?
 
-    for (size_t j = index; j < items - 1; j++) {
-      contents[j] = contents[j + 1];
-    }
-  }
-  tail--;
+  node* last = at(items - 1);
+  at(index) = last;
+  last->slot = index;
   items--;
+  trim();
 #ifdef _LIBDEBUG_
-//    for (size_t j = 0; j < items; j++) {
-//        Serial.printf("%d : %u\n", j, (uint32_t)contents[j]);
-//    }
     Serial.printf("NODEARRAY-REMOVE: removal complete\n");
     Serial.printf("NODEARRAY-REMOVE: current count: %d\n", items);
 #endif
 }
 
+#ifdef _DICT_SINGLE_ALLOC
+// put n in the place of item i (a node that moved to a new block).
+void NodeArray::replace(const node* i, const node* n) {
+  size_t index = i->slot;
+  if (index >= items || at(index) != i) return;
+  at(index) = (node*)n;
+  ((node*)n)->slot = index;
+}
+#endif
+
 
 #ifdef _LIBDEBUG_
 void NodeArray::printArray() {
   Serial.printf("\nNodeArray::printArray:\n");
   for (size_t i = 0; i < items; i++) {
-    Serial.printf("%d: %u\n", i, (uint32_t)contents[i]);
+    Serial.printf("%d: %u\n", i, (uint32_t)at(i));
   }
   Serial.println();
 }
@@ -413,98 +572,2114 @@ bool NodeArray::isEmpty() const {
 
 // check if the queue is full.
 bool NodeArray::isFull() const {
-  return items == size;
+  return items == (segs << shift);
 }
 
 // get the number of items in the queue.
 size_t NodeArray::count() const {
   return items;
 }
+#endif // _DICT_ORDERED
 
 
+#ifdef _DICT_ENGINE_HASH
+// ==== HASH INDEX ===================================================================
+// Capacity is always a power of two; a slot is empty when n == NULL. The table is
+// grown when it would become more than 80% full. Slots of a table that is being
+// drained by an incremental resize are marked with NODEHASH_TOMB instead of being
+// emptied, so probe sequences that run across them keep working until the old
+// table is released.
+#define NODEHASH_TOMB     ((node*)1)
+#define NODEHASH_MIGRATE  4     // old slots moved per insert/remove during a resize
 
+// Probe distance of a slot holding hash h at index i: how far it sits from home.
+#define NODEHASH_DIST(h, i, m)  (((i) - ((size_t)(h) & (m))) & (m))
 
-// ==== CONSTRUCTOR / DESTRUCTOR ==================================
-Dictionary::Dictionary(size_t init_size) {
-  iRoot = NULL;
-  iError = DICTIONARY_OK;
+NodeHash::NodeHash(size_t init_size) {
+  initialSize = init_size;
+  table = NULL;
+  mask = 0;
+  items = 0;
+  old = NULL;
+  oldMask = 0;
+  oldItems = 0;
+  cursor = 0;
+  // the table is allocated on first insert
+}
 
-  // This is unlikely to fail as practically no memory is allocated by the NodeArray
-  // All memory allocation is delegated to the first append
-  Q = new NodeArray(init_size);
-  initSize = init_size;
+NodeHash::~NodeHash() {
+  dictFree(table, DICT_MEM_INDEX);
+  dictFree(old, DICT_MEM_INDEX);
+  table = NULL;
+  old = NULL;
+}
 
-#ifdef _DICT_COMPRESS
-  // This however is a problem - need to think about a safer way
-  iKeyTemp = (char*) malloc(sizeof(char) * (_DICT_KEYLEN + 1));
-  iValTemp = (char*) malloc(sizeof(char) * (_DICT_VALLEN + 1));
-#else
-  iKeyTemp = NULL;
-  iValTemp = NULL;
-#endif
+// Return the index of the slot holding the key, or (size_t)-1 if absent. The
+// Robin Hood invariant lets the search stop as soon as it has probed further
+// than the resident entry did, instead of running to the next empty slot.
+size_t NodeHash::probe(const slot* tab, size_t m, uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen) {
+  size_t i = (size_t)h & m;
+  for (size_t d = 0; d <= m; d++, i = (i + 1) & m) {
+    node* n = tab[i].n;
+    if (n == NULL) break;
+    if (n == NODEHASH_TOMB) continue;
+    if (d > NODEHASH_DIST(tab[i].h, i, m)) break;
+    if (tab[i].h == h && n->ksize == keylen && memcmp(n->kbuf(), keystr, keylen) == 0) return i;
+  }
+  return (size_t)-1;
 }
 
-Dictionary::~Dictionary() {
-  destroy();
-  delete Q;
-#ifdef _DICT_COMPRESS
-  free(iKeyTemp); iKeyTemp = NULL;
-  free(iValTemp); iValTemp = NULL;
-#endif
+// Robin Hood placement: an incoming entry that has probed further than the
+// resident one takes its slot, and the resident continues the probe. The table
+// must have at least one empty slot.
+void NodeHash::place(slot* tab, size_t m, node* n, uintNN_t h) {
+  size_t i = (size_t)h & m;
+  size_t d = 0;
+  for (;;) {
+    if (tab[i].n == NULL) {
+      tab[i].n = n;
+      tab[i].h = h;
+      return;
+    }
+    size_t rd = NODEHASH_DIST(tab[i].h, i, m);
+    if (rd < d) {
+      node*    tn = tab[i].n;
+      uintNN_t th = tab[i].h;
+      tab[i].n = n;
+      tab[i].h = h;
+      n = tn;
+      h = th;
+      d = rd;
+    }
+    i = (i + 1) & m;
+    d++;
+  }
 }
 
+// Start an incremental resize to twice the capacity (or the initial capacity).
+int8_t NodeHash::grow() {
+  size_t cap = 8;
+  if (table) cap = (mask + 1) * 2;
+  else while (cap * 4 < initialSize * 5) cap *= 2;
 
+  slot* temp = (slot*)dictAlloc(sizeof(slot) * cap, DICT_MEM_INDEX);
+  if (temp == NULL) return NODEARRAY_MEM;
+  memset(temp, 0, sizeof(slot) * cap);
 
-// ==== PUBLIC METHODS ===============================================
+  if (table) {
+    old = table;
+    oldMask = mask;
+    oldItems = items;
+    cursor = 0;
+  }
+  table = temp;
+  mask = cap - 1;
+  items = 0;
+  return NODEARRAY_OK;
+}
 
-// ===== INSERTS =====================================================
+// Move up to `steps` slots of the old table into the current one.
+void NodeHash::migrate(size_t steps) {
+  while (old && steps--) {
+    node* n = old[cursor].n;
+    if (n != NULL && n != NODEHASH_TOMB) {
+      place(table, mask, n, old[cursor].h);
+      items++;
+      oldItems--;
+    }
+    old[cursor].n = NODEHASH_TOMB;
+    if (++cursor > oldMask || oldItems == 0) {
+      dictFree(old, DICT_MEM_INDEX);
+      old = NULL;
+    }
+  }
+}
 
-int8_t Dictionary::insert(const char* keystr, const char* valstr) {
-  // TODO: decide if to check for length here
-  iKeyLen = strnlen(keystr, _DICT_KEYLEN + 1);
-#ifdef _DICT_COMPRESS
-  int8_t rc;
-#endif
+int8_t NodeHash::insert(node* n, uintNN_t h) {
+  migrate(NODEHASH_MIGRATE);
+
+  if (table == NULL || (items + oldItems + 1) * 5 > (mask + 1) * 4) {
+    // A new resize cannot start while the previous one is draining; finish it
+    // first (with NODEHASH_MIGRATE slots per call this is practically never hit).
+    if (old) migrate(oldMask + 1);
+    if (grow() != NODEARRAY_OK) {
+      // No memory for a bigger table - keep filling the current one while it has
+      // a free slot (probes get longer, but nothing breaks).
+      if (table == NULL || items + 1 > mask) return NODEARRAY_MEM;
+    }
+  }
 
-  if ( iKeyLen == 0 || iKeyLen > _DICT_KEYLEN ) return DICTIONARY_ERR;
-  if ( (iValLen = strnlen(valstr, _DICT_VALLEN + 1)) > _DICT_VALLEN ) return DICTIONARY_ERR;
+  place(table, mask, n, h);
+  items++;
+  return NODEARRAY_OK;
+}
 
-#ifdef _DICT_COMPRESS
-  if ( (rc = compressKey(keystr)) ) return rc;
-  if ( (rc = compressValue(valstr)) ) return rc;
-#else
-  iKeyTemp = (char*) keystr;
-  iValTemp = (char*) valstr;
-#endif
+node* NodeHash::find(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen) {
+  if (table) {
+    size_t i = probe(table, mask, h, keystr, keylen);
+    if (i != (size_t)-1) return table[i].n;
+  }
+  if (old) {
+    size_t i = probe(old, oldMask, h, keystr, keylen);
+    if (i != (size_t)-1) return old[i].n;
+  }
+  return NULL;
+}
 
-  uintNN_t key = crc(iKeyTemp, iKeyLen);
+node* NodeHash::remove(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen) {
+  node* n = NULL;
+
+  if (table) {
+    size_t i = probe(table, mask, h, keystr, keylen);
+    if (i != (size_t)-1) {
+      n = table[i].n;
+      // Backward-shift deletion: pull the following displaced entries one slot
+      // closer to home, so the live table never needs tombstones.
+      size_t j = (i + 1) & mask;
+      while (table[j].n != NULL && NODEHASH_DIST(table[j].h, j, mask) > 0) {
+        table[i] = table[j];
+        i = j;
+        j = (j + 1) & mask;
+      }
+      table[i].n = NULL;
+      items--;
+    }
+  }
+  if (n == NULL && old) {
+    size_t i = probe(old, oldMask, h, keystr, keylen);
+    if (i != (size_t)-1) {
+      n = old[i].n;
+      old[i].n = NODEHASH_TOMB;   // the old table is only drained, never compacted
+      oldItems--;
+    }
+  }
+  migrate(NODEHASH_MIGRATE);
+  return n;
+}
 
-  if (iRoot != NULL)
-    return insert(key, iKeyTemp, iKeyLen, iValTemp, iValLen, iRoot);
+#ifdef _DICT_SINGLE_ALLOC
+void NodeHash::relink(node* n, uintNN_t h) {
+  if (table) {
+    size_t i = probe(table, mask, h, n->kbuf(), n->ksize);
+    if (i != (size_t)-1) { table[i].n = n; return; }
+  }
+  if (old) {
+    size_t i = probe(old, oldMask, h, n->kbuf(), n->ksize);
+    if (i != (size_t)-1) old[i].n = n;
+  }
+}
+#endif
+#endif // _DICT_ENGINE_HASH
+
+
+#ifdef _DICT_ENGINE_SWISS
+// ==== SWISS INDEX ==================================================================
+// Control byte values: 0x00-0x7F hold the low 7 bits of a live slot's hash.
+#define NODESWISS_EMPTY     0x80
+#define NODESWISS_DELETED   0xFE
+#define NODESWISS_GROUP     16
+
+// The tag is the low 7 bits of the key hash and the home group comes from the
+// bits above them. A 16-bit hash has only 9 bits left there, so it is spread over
+// 32 bits first (Fibonacci hashing); otherwise tables past 512 groups would only
+// ever use their first 512 as homes.
+#define NODESWISS_TAG(h)    ((uint8_t)((h) & 0x7F))
+#if _DICT_CRC == 16
+#define NODESWISS_HOME(h)   ((size_t)(((uint32_t)(h) * 0x9E3779B1UL) >> 7))
+#else
+#define NODESWISS_HOME(h)   ((size_t)((h) >> 7))
+#endif
+
+// Bit i of the result is set when control byte i of the group equals b.
+static inline uint32_t nodeSwissMatch(const uint8_t* group, uint8_t b) {
+#ifdef _DICT_HAVE_SSE2
+  __m128i g = _mm_loadu_si128((const __m128i*) group);
+  return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char) b)));
+#else
+  uint32_t m = 0;
+  for (uint8_t i = 0; i < NODESWISS_GROUP; i++) {
+    if (group[i] == b) m |= (1UL << i);
+  }
+  return m;
+#endif
+}
+
+// Index of the lowest set bit (mask is never 0 when called).
+static inline uint8_t nodeSwissFirst(uint32_t m) {
+#if defined(__GNUC__)
+  return (uint8_t) __builtin_ctz(m);
+#else
+  uint8_t i = 0;
+  while (!(m & 1)) { m >>= 1; i++; }
+  return i;
+#endif
+}
+
+NodeSwiss::NodeSwiss(size_t init_size) {
+  initialSize = init_size;
+  slots = NULL;
+  ctrl = NULL;
+  gmask = 0;
+  items = 0;
+  growthLeft = 0;
+}
+
+NodeSwiss::~NodeSwiss() {
+  dictFree(slots, DICT_MEM_INDEX);
+  slots = NULL;
+  ctrl = NULL;
+}
+
+// Return the slot index of the key, or (size_t)-1. Probing stops at the first
+// group that still has an empty slot: an insert would have used it.
+size_t NodeSwiss::locate(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen) {
+  if (slots == NULL) return (size_t)-1;
+
+  uint8_t tag = NODESWISS_TAG(h);
+  size_t  g = NODESWISS_HOME(h) & gmask;
+
+  for (size_t step = 1; step <= gmask + 1; g = (g + step++) & gmask) {
+    const uint8_t* group = ctrl + g * NODESWISS_GROUP;
+    for (uint32_t m = nodeSwissMatch(group, tag); m; m &= m - 1) {
+      size_t i = g * NODESWISS_GROUP + nodeSwissFirst(m);
+      node*  n = slots[i];
+      if (n->ksize == keylen && memcmp(n->kbuf(), keystr, keylen) == 0) return i;
+    }
+    if (nodeSwissMatch(group, NODESWISS_EMPTY)) break;
+  }
+  return (size_t)-1;
+}
+
+// First empty or deleted slot on the probe sequence of h (one always exists).
+size_t NodeSwiss::freeSlot(uintNN_t h) {
+  size_t g = NODESWISS_HOME(h) & gmask;
+
+  for (size_t step = 1; ; g = (g + step++) & gmask) {
+    const uint8_t* group = ctrl + g * NODESWISS_GROUP;
+    uint32_t m = nodeSwissMatch(group, NODESWISS_EMPTY) | nodeSwissMatch(group, NODESWISS_DELETED);
+    if (m) return g * NODESWISS_GROUP + nodeSwissFirst(m);
+  }
+}
+
+// Rebuild the table with the given number of groups, dropping deleted markers.
+// Node hashes are not stored, so they are recomputed from the keys.
+int8_t NodeSwiss::rehash(size_t groups) {
+  size_t cap = groups * NODESWISS_GROUP;
+  node** temp = (node**)dictAlloc((sizeof(node*) + 1) * cap, DICT_MEM_INDEX);
+  if (temp == NULL) return NODEARRAY_MEM;
+
+  node**   oldSlots = slots;
+  uint8_t* oldCtrl = ctrl;
+  size_t   oldCap = slots ? (gmask + 1) * NODESWISS_GROUP : 0;
+
+  slots = temp;
+  ctrl = (uint8_t*)(temp + cap);
+  memset(ctrl, NODESWISS_EMPTY, cap);
+  gmask = groups - 1;
+  growthLeft = cap - cap / 8 - items;
+
+  for (size_t i = 0; i < oldCap; i++) {
+    if (oldCtrl[i] & 0x80) continue;    // empty or deleted
+    node*    n = oldSlots[i];
+    uintNN_t h = Dictionary::crc(n->kbuf(), n->ksize);
+    size_t   j = freeSlot(h);
+    ctrl[j] = NODESWISS_TAG(h);
+    slots[j] = n;
+  }
+  dictFree(oldSlots, DICT_MEM_INDEX);
+  return NODEARRAY_OK;
+}
+
+int8_t NodeSwiss::insert(node* n, uintNN_t h) {
+  if (growthLeft == 0) {
+    size_t groups = 1;
+    if (slots == NULL) {
+      while (groups * NODESWISS_GROUP * 7 < initialSize * 8) groups *= 2;
+    }
+    else {
+      groups = gmask + 1;
+      // Mostly deleted markers rather than live nodes: same size is enough.
+      if (items * 16 > groups * NODESWISS_GROUP * 7) groups *= 2;
+    }
+    int8_t rc = rehash(groups);
+    if (rc) return rc;
+  }
+
+  size_t i = freeSlot(h);
+  if (ctrl[i] == NODESWISS_EMPTY) growthLeft--;   // reusing a deleted slot is free
+  ctrl[i] = NODESWISS_TAG(h);
+  slots[i] = n;
+  items++;
+  return NODEARRAY_OK;
+}
+
+node* NodeSwiss::find(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen) {
+  size_t i = locate(h, keystr, keylen);
+  return (i == (size_t)-1) ? NULL : slots[i];
+}
+
+#ifdef _DICT_SINGLE_ALLOC
+void NodeSwiss::relink(node* n, uintNN_t h) {
+  size_t i = locate(h, n->kbuf(), n->ksize);
+  if (i != (size_t)-1) slots[i] = n;
+}
+#endif
+
+node* NodeSwiss::remove(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen) {
+  size_t i = locate(h, keystr, keylen);
+  if (i == (size_t)-1) return NULL;
+
+  node* n = slots[i];
+  // A group that still has an empty slot never made a probe move past it, so
+  // the slot can go straight back to empty; otherwise leave a deleted marker.
+  const uint8_t* group = ctrl + (i & ~(size_t)(NODESWISS_GROUP - 1));
+  if (nodeSwissMatch(group, NODESWISS_EMPTY)) {
+    ctrl[i] = NODESWISS_EMPTY;
+    growthLeft++;
+  }
+  else {
+    ctrl[i] = NODESWISS_DELETED;
+  }
+  items--;
+  return n;
+}
+#endif // _DICT_ENGINE_SWISS
+
+
+#ifdef _DICT_ENGINE_ART
+// ==== ART INDEX ====================================================================
+#define NODEART_4       0
+#define NODEART_16      1
+#define NODEART_48      2
+#define NODEART_256     3
+
+// Child pointers with the low bit set are dictionary nodes (leaves); malloc'd
+// memory is at least 2-byte aligned, so the bit is otherwise always clear.
+#define NODEART_IS_LEAF(p)  ((uintptr_t)(p) & 1)
+#define NODEART_LEAF(p)     ((node*)((uintptr_t)(p) & ~(uintptr_t)1))
+#define NODEART_TAG(n)      ((void*)((uintptr_t)(n) | 1))
+
+struct nodeArtHeader {
+  uint8_t         type;
+  uint16_t        count;    // children
+  _DICT_KEY_TYPE  plen;     // compressed path length; the bytes follow the node
+  node*           leaf;     // key that ends at this node (after the path)
+};
+
+struct nodeArt4   { nodeArtHeader h; uint8_t keys[4];    void* child[4]; };
+struct nodeArt16  { nodeArtHeader h; uint8_t keys[16];   void* child[16]; };
+struct nodeArt48  { nodeArtHeader h; uint8_t index[256]; void* child[48]; };   // index: slot + 1, 0 = none
+struct nodeArt256 { nodeArtHeader h; void* child[256]; };
+
+static const size_t nodeArtSizes[4] = { sizeof(nodeArt4), sizeof(nodeArt16), sizeof(nodeArt48), sizeof(nodeArt256) };
+
+static inline uint8_t* nodeArtPath(nodeArtHeader* n) {
+  return (uint8_t*)n + nodeArtSizes[n->type];
+}
+
+static nodeArtHeader* nodeArtNew(uint8_t type, size_t plen) {
+  size_t sz = nodeArtSizes[type] + plen;
+  nodeArtHeader* n = (nodeArtHeader*)dictAlloc(sz, DICT_MEM_INDEX);
+  if (n == NULL) return NULL;
+  memset(n, 0, nodeArtSizes[type]);
+  n->type = type;
+  n->plen = (_DICT_KEY_TYPE) plen;
+  return n;
+}
+
+// Slot holding the child for byte c, or NULL.
+static void** nodeArtFind(nodeArtHeader* n, uint8_t c) {
+  switch (n->type) {
+    case NODEART_4: {
+      nodeArt4* a = (nodeArt4*)n;
+      for (uint16_t i = 0; i < n->count; i++) {
+        if (a->keys[i] == c) return &a->child[i];
+      }
+      return NULL;
+    }
+    case NODEART_16: {
+      nodeArt16* a = (nodeArt16*)n;
+#ifdef _DICT_HAVE_SSE2
+      __m128i  k = _mm_loadu_si128((const __m128i*) a->keys);
+      uint32_t m = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(k, _mm_set1_epi8((char) c)));
+      m &= (1UL << n->count) - 1;
+      return m ? &a->child[__builtin_ctz(m)] : NULL;
+#else
+      for (uint16_t i = 0; i < n->count; i++) {
+        if (a->keys[i] == c) return &a->child[i];
+      }
+      return NULL;
+#endif
+    }
+    case NODEART_48: {
+      nodeArt48* a = (nodeArt48*)n;
+      return a->index[c] ? &a->child[a->index[c] - 1] : NULL;
+    }
+    default: {
+      nodeArt256* a = (nodeArt256*)n;
+      return a->child[c] ? &a->child[c] : NULL;
+    }
+  }
+}
+
+// Add child for byte c (not present yet). A full node is replaced by the next
+// size up and *ref is repointed; on a failed allocation nothing changes.
+static int8_t nodeArtAdd(void** ref, nodeArtHeader* n, uint8_t c, void* child) {
+  if ((n->type == NODEART_4 && n->count == 4) || (n->type == NODEART_16 && n->count == 16) || (n->type == NODEART_48 && n->count == 48)) {
+    nodeArtHeader* g = nodeArtNew(n->type + 1, n->plen);
+    if (g == NULL) return NODEARRAY_MEM;
+    g->count = n->count;
+    g->leaf = n->leaf;
+    memcpy(nodeArtPath(g), nodeArtPath(n), n->plen);
+
+    if (n->type == NODEART_4) {
+      memcpy(((nodeArt16*)g)->keys, ((nodeArt4*)n)->keys, 4);
+      memcpy(((nodeArt16*)g)->child, ((nodeArt4*)n)->child, 4 * sizeof(void*));
+    }
+    else if (n->type == NODEART_16) {
+      nodeArt16* a = (nodeArt16*)n;
+      nodeArt48* b = (nodeArt48*)g;
+      for (uint8_t i = 0; i < 16; i++) {
+        b->index[a->keys[i]] = i + 1;
+        b->child[i] = a->child[i];
+      }
+    }
+    else {
+      nodeArt48*  a = (nodeArt48*)n;
+      nodeArt256* b = (nodeArt256*)g;
+      for (uint16_t i = 0; i < 256; i++) {
+        if (a->index[i]) b->child[i] = a->child[a->index[i] - 1];
+      }
+    }
+    dictFree(n, DICT_MEM_INDEX);
+    *ref = g;
+    n = g;
+  }
+
+  switch (n->type) {
+    case NODEART_4:
+    case NODEART_16: {
+      // keys stay sorted so walks come out in key order
+      uint8_t* keys  = (n->type == NODEART_4) ? ((nodeArt4*)n)->keys : ((nodeArt16*)n)->keys;
+      void**   kids  = (n->type == NODEART_4) ? ((nodeArt4*)n)->child : ((nodeArt16*)n)->child;
+      uint16_t i = n->count;
+      while (i > 0 && keys[i - 1] > c) {
+        keys[i] = keys[i - 1];
+        kids[i] = kids[i - 1];
+        i--;
+      }
+      keys[i] = c;
+      kids[i] = child;
+      break;
+    }
+    case NODEART_48: {
+      nodeArt48* a = (nodeArt48*)n;
+      uint8_t i = 0;
+      while (a->child[i]) i++;
+      a->child[i] = child;
+      a->index[c] = i + 1;
+      break;
+    }
+    default:
+      ((nodeArt256*)n)->child[c] = child;
+  }
+  n->count++;
+  return NODEARRAY_OK;
+}
+
+static void nodeArtRemoveChild(nodeArtHeader* n, uint8_t c) {
+  switch (n->type) {
+    case NODEART_4:
+    case NODEART_16: {
+      uint8_t* keys  = (n->type == NODEART_4) ? ((nodeArt4*)n)->keys : ((nodeArt16*)n)->keys;
+      void**   kids  = (n->type == NODEART_4) ? ((nodeArt4*)n)->child : ((nodeArt16*)n)->child;
+      uint16_t i = 0;
+      while (keys[i] != c) i++;
+      for (; i + 1 < n->count; i++) {
+        keys[i] = keys[i + 1];
+        kids[i] = kids[i + 1];
+      }
+      break;
+    }
+    case NODEART_48: {
+      nodeArt48* a = (nodeArt48*)n;
+      a->child[a->index[c] - 1] = NULL;
+      a->index[c] = 0;
+      break;
+    }
+    default:
+      ((nodeArt256*)n)->child[c] = NULL;
+  }
+  n->count--;
+}
+
+// The child at position >= *pos in key byte order (array index for the small
+// nodes, byte value for the large ones), or NULL; *pos is set past it.
+static void* nodeArtNext(nodeArtHeader* n, uint16_t* pos) {
+  uint16_t i = *pos;
+  switch (n->type) {
+    case NODEART_4:
+      if (i >= n->count) return NULL;
+      *pos = i + 1;
+      return ((nodeArt4*)n)->child[i];
+    case NODEART_16:
+      if (i >= n->count) return NULL;
+      *pos = i + 1;
+      return ((nodeArt16*)n)->child[i];
+    case NODEART_48: {
+      nodeArt48* a = (nodeArt48*)n;
+      for (; i < 256; i++) {
+        if (a->index[i]) {
+          *pos = i + 1;
+          return a->child[a->index[i] - 1];
+        }
+      }
+      return NULL;
+    }
+    default: {
+      nodeArt256* a = (nodeArt256*)n;
+      for (; i < 256; i++) {
+        if (a->child[i]) {
+          *pos = i + 1;
+          return a->child[i];
+        }
+      }
+      return NULL;
+    }
+  }
+}
+
+// Hang node l off inner node m, whose path ends at depth: on m itself if the key
+// ends there, otherwise as the child for its next byte (m must have room).
+static void nodeArtPlace(nodeArtHeader* m, node* l, size_t depth) {
+  if (l->ksize == depth) {
+    m->leaf = l;
+  }
+  else {
+    void* ref = m;
+    nodeArtAdd(&ref, m, (uint8_t) l->kbuf()[depth], NODEART_TAG(l));
+  }
+}
+
+NodeArt::NodeArt(size_t) {
+  root = NULL;
+}
+
+// Inner nodes are freed iteratively: the list of nodes still to free is threaded
+// through their (no longer needed) leaf pointers.
+NodeArt::~NodeArt() {
+  nodeArtHeader* todo = NULL;
+  if (root && !NODEART_IS_LEAF(root)) {
+    todo = (nodeArtHeader*)root;
+    todo->leaf = NULL;
+  }
+  while (todo) {
+    nodeArtHeader* n = todo;
+    todo = (nodeArtHeader*)n->leaf;
+    uint16_t pos = 0;
+    void*    c;
+    while ((c = nodeArtNext(n, &pos)) != NULL) {
+      if (NODEART_IS_LEAF(c)) continue;
+      ((nodeArtHeader*)c)->leaf = (node*)todo;
+      todo = (nodeArtHeader*)c;
+    }
+    dictFree(n, DICT_MEM_INDEX);
+  }
+  root = NULL;
+}
+
+int8_t NodeArt::insert(node* l, uintNN_t) {
+  const char*    key = l->kbuf();
+  _DICT_KEY_TYPE keylen = l->ksize;
+  void**         ref = &root;
+  size_t         depth = 0;
+
+  while (true) {
+    void* cur = *ref;
+    if (cur == NULL) {    // empty tree
+      *ref = NODEART_TAG(l);
+      return NODEARRAY_OK;
+    }
+
+    if (NODEART_IS_LEAF(cur)) {
+      // Two keys on one path: a new inner node takes their common bytes.
+      node*  o = NODEART_LEAF(cur);
+      size_t lim = (o->ksize < keylen) ? o->ksize : keylen;
+      size_t p = depth;
+      while (p < lim && o->kbuf()[p] == key[p]) p++;
+
+      nodeArtHeader* m = nodeArtNew(NODEART_4, p - depth);
+      if (m == NULL) return NODEARRAY_MEM;
+      memcpy(nodeArtPath(m), key + depth, p - depth);
+      nodeArtPlace(m, o, p);
+      nodeArtPlace(m, l, p);
+      *ref = m;
+      return NODEARRAY_OK;
+    }
+
+    nodeArtHeader* n = (nodeArtHeader*)cur;
+    uint8_t*       path = nodeArtPath(n);
+    size_t         p = 0;
+    while (p < n->plen && depth + p < keylen && path[p] == (uint8_t)key[depth + p]) p++;
+
+    if (p < n->plen) {
+      // The key leaves the compressed path: split it at the first difference.
+      nodeArtHeader* m = nodeArtNew(NODEART_4, p);
+      if (m == NULL) return NODEARRAY_MEM;
+      memcpy(nodeArtPath(m), path, p);
+      uint8_t c = path[p];
+      memmove(path, path + p + 1, n->plen - p - 1);
+      n->plen -= p + 1;
+      void* mref = m;
+      nodeArtAdd(&mref, m, c, n);
+      nodeArtPlace(m, l, depth + p);
+      *ref = m;
+      return NODEARRAY_OK;
+    }
+
+    depth += n->plen;
+    if (depth == keylen) {
+      n->leaf = l;
+      return NODEARRAY_OK;
+    }
+
+    void** s = nodeArtFind(n, (uint8_t)key[depth]);
+    if (s == NULL) return nodeArtAdd(ref, n, (uint8_t)key[depth], NODEART_TAG(l));
+    ref = s;
+    depth++;
+  }
+}
+
+node* NodeArt::find(uintNN_t, const char* keystr, _DICT_KEY_TYPE keylen) {
+  void*  cur = root;
+  size_t depth = 0;
+
+  while (cur) {
+    if (NODEART_IS_LEAF(cur)) {
+      node* l = NODEART_LEAF(cur);
+      return (l->ksize == keylen && memcmp(l->kbuf(), keystr, keylen) == 0) ? l : NULL;
+    }
+    nodeArtHeader* n = (nodeArtHeader*)cur;
+    if (n->plen) {
+      if (keylen - depth < n->plen || memcmp(nodeArtPath(n), keystr + depth, n->plen) != 0) return NULL;
+      depth += n->plen;
+    }
+    if (depth == keylen) return n->leaf;
+
+    void** s = nodeArtFind(n, (uint8_t)keystr[depth]);
+    if (s == NULL) return NULL;
+    cur = *s;
+    depth++;
+  }
+  return NULL;
+}
+
+node* NodeArt::remove(uintNN_t, const char* keystr, _DICT_KEY_TYPE keylen) {
+  void**         ref = &root;
+  nodeArtHeader* parent = NULL;
+  size_t         depth = 0;
+
+  while (*ref) {
+    void* cur = *ref;
+    if (NODEART_IS_LEAF(cur)) {
+      node* l = NODEART_LEAF(cur);
+      if (l->ksize != keylen || memcmp(l->kbuf(), keystr, keylen) != 0) return NULL;
+      if (parent) {
+        nodeArtRemoveChild(parent, (uint8_t)keystr[depth - 1]);
+        prune(parent, keystr);
+      }
+      else {
+        root = NULL;
+      }
+      return l;
+    }
+
+    nodeArtHeader* n = (nodeArtHeader*)cur;
+    if (n->plen) {
+      if (keylen - depth < n->plen || memcmp(nodeArtPath(n), keystr + depth, n->plen) != 0) return NULL;
+      depth += n->plen;
+    }
+    if (depth == keylen) {
+      node* l = n->leaf;
+      if (l) {
+        n->leaf = NULL;
+        prune(n, keystr);
+      }
+      return l;
+    }
+
+    void** s = nodeArtFind(n, (uint8_t)keystr[depth]);
+    if (s == NULL) return NULL;
+    parent = n;
+    ref = s;
+    depth++;
+  }
+  return NULL;
+}
+
+#ifdef _DICT_SINGLE_ALLOC
+void NodeArt::relink(node* l, uintNN_t) {
+  void**      ref = &root;
+  const char* key = l->kbuf();
+  size_t      depth = 0;
+
+  while (*ref) {
+    if (NODEART_IS_LEAF(*ref)) {
+      *ref = NODEART_TAG(l);
+      return;
+    }
+    nodeArtHeader* n = (nodeArtHeader*)*ref;
+    depth += n->plen;
+    if (depth == l->ksize) {
+      n->leaf = l;
+      return;
+    }
+    ref = nodeArtFind(n, (uint8_t)key[depth]);
+    if (ref == NULL) return;
+    depth++;
+  }
+}
+#endif
+
+// Free inner node n (on the path of keystr) and then its ancestors while they
+// hold neither children nor a key. The parent is found by walking the key again,
+// which is rare and keeps remove() free of a path stack.
+void NodeArt::prune(void* target, const char* keystr) {
+  nodeArtHeader* n = (nodeArtHeader*)target;
+
+  while (n->count == 0 && n->leaf == NULL) {
+    nodeArtHeader* parent = NULL;
+    void*          cur = root;
+    size_t         depth = 0;
+    while (cur != n) {
+      parent = (nodeArtHeader*)cur;
+      depth += parent->plen;
+      cur = *nodeArtFind(parent, (uint8_t)keystr[depth]);
+      depth++;
+    }
+    dictFree(n, DICT_MEM_INDEX);
+    if (parent == NULL) {
+      root = NULL;
+      return;
+    }
+    nodeArtRemoveChild(parent, (uint8_t)keystr[depth - 1]);
+    n = parent;
+  }
+}
+
+size_t NodeArt::forEachPrefix(const char* prefix, size_t plen, DictionaryCallback cb, void* ctx) {
+  void*  cur = root;
+  size_t depth = 0;
+
+  // Descend to the subtree that holds exactly the keys starting with prefix.
+  while (cur && depth < plen && !NODEART_IS_LEAF(cur)) {
+    nodeArtHeader* n = (nodeArtHeader*)cur;
+    size_t m = (n->plen < plen - depth) ? n->plen : plen - depth;
+    if (memcmp(nodeArtPath(n), prefix + depth, m) != 0) return 0;
+    depth += n->plen;
+    if (depth >= plen) break;
+
+    void** s = nodeArtFind(n, (uint8_t)prefix[depth]);
+    if (s == NULL) return 0;
+    cur = *s;
+    depth++;
+  }
+  if (cur == NULL) return 0;
+
+  if (NODEART_IS_LEAF(cur)) {
+    node* l = NODEART_LEAF(cur);
+    if (l->ksize < plen || memcmp(l->kbuf(), prefix, plen) != 0) return 0;
+    cb(String(l->kbuf()), String(l->vbuf()), ctx);
+    return 1;
+  }
+
+  // Depth-first walk; every level below consumes at least one key byte, so the
+  // stack never holds more than _DICT_KEYLEN + 1 nodes.
+  struct level {
+    nodeArtHeader*  n;
+    uint16_t        pos;      // 0 = own key not visited yet, then next child + 1
+  };
+  level* stack = (level*) dictAlloc(sizeof(level) * (_DICT_KEYLEN + 2), DICT_MEM_INDEX);
+  if (stack == NULL) return (size_t)-1;
+
+  size_t found = 0;
+  size_t top = 1;
+  stack[0].n = (nodeArtHeader*)cur;
+  stack[0].pos = 0;
+  while (top) {
+    level& w = stack[top - 1];
+    if (w.pos == 0) {
+      w.pos = 1;
+      if (w.n->leaf) {
+        cb(String(w.n->leaf->kbuf()), String(w.n->leaf->vbuf()), ctx);
+        found++;
+      }
+      continue;
+    }
+    uint16_t pos = w.pos - 1;
+    void*    c = nodeArtNext(w.n, &pos);
+    if (c == NULL) {
+      top--;
+      continue;
+    }
+    w.pos = pos + 1;
+    if (NODEART_IS_LEAF(c)) {
+      node* l = NODEART_LEAF(c);
+      cb(String(l->kbuf()), String(l->vbuf()), ctx);
+      found++;
+    }
+    else {
+      stack[top].n = (nodeArtHeader*)c;
+      stack[top].pos = 0;
+      top++;
+    }
+  }
+  dictFree(stack, DICT_MEM_INDEX);
+  return found;
+}
+#endif // _DICT_ENGINE_ART
+
+
+#ifdef _DICT_ENGINE_BTREE
+// ==== B-TREE INDEX =================================================================
+#define NODEBTREE_KEYS      (_DICT_BTREE_ORDER - 1)
+#define NODEBTREE_MIN       (_DICT_BTREE_ORDER / 2 - 1)     // fewest keys in a non-root node
+#define NODEBTREE_SLOTS     ((NODEBTREE_KEYS + 3) & ~3)     // prefix array, padded for 4-wide loads
+
+// What remove() is looking for below the current node: the key itself, or the
+// in-order neighbour that replaces it in an inner node.
+#define NODEBTREE_KEY       0
+#define NODEBTREE_LAST      1
+#define NODEBTREE_FIRST     2
+
+// The prefixes come first so that searching a node reads one contiguous array.
+// Leaves are allocated without the child array.
+struct nodeBtree {
+  uintNN_t    keys[NODEBTREE_SLOTS];      // key prefix of items[0..count-1], ascending
+  node*       items[NODEBTREE_KEYS];
+  uint8_t     count;
+  uint8_t     leaf;
+  nodeBtree*  child[_DICT_BTREE_ORDER];   // inner nodes only: count + 1 children
+};
+
+static nodeBtree* nodeBtreeNew(bool leaf) {
+  size_t sz = sizeof(nodeBtree) - (leaf ? sizeof(nodeBtree*) * _DICT_BTREE_ORDER : 0);   // child[] is last
+  nodeBtree* n = (nodeBtree*)dictAlloc(sz, DICT_MEM_INDEX);
+  if (n == NULL) return NULL;
+  memset(n, 0, sz);
+  n->leaf = leaf;
+  return n;
+}
+
+// Number of leading prefixes below h.
+static inline uint8_t nodeBtreeBelow(const nodeBtree* n, uintNN_t h) {
+#if defined(_DICT_HAVE_SSE2) && _DICT_CRC == 32
+  // SSE2 only has signed compares: flipping the sign bits orders unsigned values.
+  const __m128i bias = _mm_set1_epi32((int) 0x80000000UL);
+  const __m128i x = _mm_xor_si128(_mm_set1_epi32((int) h), bias);
+  uint8_t i = 0;
+  while (i < n->count) {
+    __m128i  k = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(n->keys + i)), bias);
+    uint32_t m = (uint32_t) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(k, x)));
+    uint8_t  left = n->count - i;
+    if (left < 4) m &= (1UL << left) - 1;
+    if (m != 0xF) return i + (m & 1) + ((m >> 1) & 1) + ((m >> 2) & 1);  // sorted: m is 0, 1, 3 or 7
+    i += 4;
+  }
+  return i;
+#else
+  uint8_t i = 0;
+  while (i < n->count && n->keys[i] < h) i++;
+  return i;
+#endif
+}
+
+// Key order: prefix, then length, then bytes. Only equal prefixes read the key.
+static inline int nodeBtreeCompare(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen, uintNN_t eh, const node* e) {
+  if (h != eh) return (h < eh) ? -1 : 1;
+  if (keylen != e->ksize) return (keylen < e->ksize) ? -1 : 1;
+  return memcmp(keystr, e->kbuf(), keylen);
+}
+
+// Position of the first item not below the key; *hit is set if it is the key.
+static uint8_t nodeBtreeRank(const nodeBtree* n, uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen, bool* hit) {
+  uint8_t i = nodeBtreeBelow(n, h);
+  *hit = false;
+  while (i < n->count && n->keys[i] == h) {
+    int c = nodeBtreeCompare(h, keystr, keylen, h, n->items[i]);
+    if (c == 0) *hit = true;
+    if (c <= 0) break;
+    i++;
+  }
+  return i;
+}
+
+// Split the full child i of x around its middle item, which moves up into x
+// (x is never full here).
+static int8_t nodeBtreeSplit(nodeBtree* x, uint8_t i) {
+  nodeBtree* c = x->child[i];
+  nodeBtree* r = nodeBtreeNew(c->leaf);
+  if (r == NULL) return NODEARRAY_MEM;
+
+  r->count = NODEBTREE_MIN;
+  memcpy(r->keys, c->keys + NODEBTREE_MIN + 1, NODEBTREE_MIN * sizeof(uintNN_t));
+  memcpy(r->items, c->items + NODEBTREE_MIN + 1, NODEBTREE_MIN * sizeof(node*));
+  if (!c->leaf) memcpy(r->child, c->child + NODEBTREE_MIN + 1, (NODEBTREE_MIN + 1) * sizeof(nodeBtree*));
+  c->count = NODEBTREE_MIN;
+
+  memmove(x->keys + i + 1, x->keys + i, (x->count - i) * sizeof(uintNN_t));
+  memmove(x->items + i + 1, x->items + i, (x->count - i) * sizeof(node*));
+  memmove(x->child + i + 2, x->child + i + 1, (x->count - i) * sizeof(nodeBtree*));
+  x->keys[i] = c->keys[NODEBTREE_MIN];
+  x->items[i] = c->items[NODEBTREE_MIN];
+  x->child[i + 1] = r;
+  x->count++;
+  return NODEARRAY_OK;
+}
+
+// Merge child i + 1 of x, and the item between the two, into child i. Both
+// children hold NODEBTREE_MIN keys, so the result is exactly full.
+static void nodeBtreeMerge(nodeBtree* x, uint8_t i) {
+  nodeBtree* c = x->child[i];
+  nodeBtree* s = x->child[i + 1];
+
+  c->keys[c->count] = x->keys[i];
+  c->items[c->count] = x->items[i];
+  memcpy(c->keys + c->count + 1, s->keys, s->count * sizeof(uintNN_t));
+  memcpy(c->items + c->count + 1, s->items, s->count * sizeof(node*));
+  if (!c->leaf) memcpy(c->child + c->count + 1, s->child, (s->count + 1) * sizeof(nodeBtree*));
+  c->count += s->count + 1;
+
+  memmove(x->keys + i, x->keys + i + 1, (x->count - i - 1) * sizeof(uintNN_t));
+  memmove(x->items + i, x->items + i + 1, (x->count - i - 1) * sizeof(node*));
+  memmove(x->child + i + 1, x->child + i + 2, (x->count - i - 1) * sizeof(nodeBtree*));
+  x->count--;
+  dictFree(s, DICT_MEM_INDEX);
+}
+
+// Child i of x holds only NODEBTREE_MIN keys: give it one more, by rotating an
+// item through x from a sibling that can spare one, or else by merging it with a
+// sibling. Returns the index of the child that now covers the old child's keys.
+static uint8_t nodeBtreeFill(nodeBtree* x, uint8_t i) {
+  nodeBtree* c = x->child[i];
+
+  if (i > 0 && x->child[i - 1]->count > NODEBTREE_MIN) {
+    nodeBtree* s = x->child[i - 1];
+    memmove(c->keys + 1, c->keys, c->count * sizeof(uintNN_t));
+    memmove(c->items + 1, c->items, c->count * sizeof(node*));
+    if (!c->leaf) {
+      memmove(c->child + 1, c->child, (c->count + 1) * sizeof(nodeBtree*));
+      c->child[0] = s->child[s->count];
+    }
+    c->keys[0] = x->keys[i - 1];
+    c->items[0] = x->items[i - 1];
+    c->count++;
+    s->count--;
+    x->keys[i - 1] = s->keys[s->count];
+    x->items[i - 1] = s->items[s->count];
+    return i;
+  }
+
+  if (i < x->count && x->child[i + 1]->count > NODEBTREE_MIN) {
+    nodeBtree* s = x->child[i + 1];
+    c->keys[c->count] = x->keys[i];
+    c->items[c->count] = x->items[i];
+    if (!c->leaf) c->child[c->count + 1] = s->child[0];
+    c->count++;
+    x->keys[i] = s->keys[0];
+    x->items[i] = s->items[0];
+    s->count--;
+    memmove(s->keys, s->keys + 1, s->count * sizeof(uintNN_t));
+    memmove(s->items, s->items + 1, s->count * sizeof(node*));
+    if (!s->leaf) memmove(s->child, s->child + 1, (s->count + 1) * sizeof(nodeBtree*));
+    return i;
+  }
+
+  if (i == x->count) i--;     // the last child merges into its left sibling
+  nodeBtreeMerge(x, i);
+  return i;
+}
+
+NodeBtree::NodeBtree(size_t) {
+  root = NULL;
+}
+
+// Nodes are freed iteratively: the list of nodes still to free is threaded
+// through their first item pointer, which is no longer needed.
+NodeBtree::~NodeBtree() {
+  nodeBtree* todo = (nodeBtree*)root;
+  if (todo) todo->items[0] = NULL;
+  while (todo) {
+    nodeBtree* n = todo;
+    todo = (nodeBtree*)n->items[0];
+    if (!n->leaf) {
+      for (uint8_t i = 0; i <= n->count; i++) {
+        n->child[i]->items[0] = (node*)todo;
+        todo = n->child[i];
+      }
+    }
+    dictFree(n, DICT_MEM_INDEX);
+  }
+  root = NULL;
+}
+
+int8_t NodeBtree::insert(node* l, uintNN_t h) {
+  nodeBtree* x = (nodeBtree*)root;
+
+  if (x == NULL) {
+    x = nodeBtreeNew(true);
+    if (x == NULL) return NODEARRAY_MEM;
+    x->keys[0] = h;
+    x->items[0] = l;
+    x->count = 1;
+    root = x;
+    return NODEARRAY_OK;
+  }
+
+  if (x->count == NODEBTREE_KEYS) {   // a full root: the tree grows by one level
+    nodeBtree* r = nodeBtreeNew(false);
+    if (r == NULL) return NODEARRAY_MEM;
+    r->child[0] = x;
+    if (nodeBtreeSplit(r, 0) != NODEARRAY_OK) {
+      dictFree(r, DICT_MEM_INDEX);
+      return NODEARRAY_MEM;
+    }
+    root = x = r;
+  }
+
+  // Full children are split before descending into them, so the leaf reached has
+  // room. A failed split leaves a valid (just not yet updated) tree.
+  while (true) {
+    bool    hit;
+    uint8_t i = nodeBtreeRank(x, h, l->kbuf(), l->ksize, &hit);
+
+    if (x->leaf) {
+      memmove(x->keys + i + 1, x->keys + i, (x->count - i) * sizeof(uintNN_t));
+      memmove(x->items + i + 1, x->items + i, (x->count - i) * sizeof(node*));
+      x->keys[i] = h;
+      x->items[i] = l;
+      x->count++;
+      return NODEARRAY_OK;
+    }
+
+    if (x->child[i]->count == NODEBTREE_KEYS) {
+      if (nodeBtreeSplit(x, i) != NODEARRAY_OK) return NODEARRAY_MEM;
+      if (nodeBtreeCompare(h, l->kbuf(), l->ksize, x->keys[i], x->items[i]) > 0) i++;
+    }
+    x = x->child[i];
+  }
+}
+
+node* NodeBtree::find(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen) {
+  nodeBtree* x = (nodeBtree*)root;
+
+  while (x) {
+    bool    hit;
+    uint8_t i = nodeBtreeRank(x, h, keystr, keylen, &hit);
+    if (hit) return x->items[i];
+    if (x->leaf) return NULL;
+    x = x->child[i];
+  }
+  return NULL;
+}
+
+#ifdef _DICT_SINGLE_ALLOC
+void NodeBtree::relink(node* n, uintNN_t h) {
+  nodeBtree* x = (nodeBtree*)root;
+
+  while (x) {
+    bool    hit;
+    uint8_t i = nodeBtreeRank(x, h, n->kbuf(), n->ksize, &hit);
+    if (hit) { x->items[i] = n; return; }
+    if (x->leaf) return;
+    x = x->child[i];
+  }
+}
+#endif
+
+// Single top-down pass: every child is given more than NODEBTREE_MIN keys before
+// the walk enters it, so the item can be taken out of a leaf without underflow.
+// A key found in an inner node is replaced by its in-order neighbour from the
+// larger child, which is then removed from that child's leaf.
+node* NodeBtree::remove(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen) {
+  nodeBtree* x = (nodeBtree*)root;
+  nodeBtree* hole = NULL;     // inner node whose item is being replaced
+  uint8_t    holeAt = 0;
+  uint8_t    want = NODEBTREE_KEY;
+  node*      found = NULL;
+
+  while (x) {
+    bool    hit = false;
+    uint8_t i;
+    if (want == NODEBTREE_KEY) i = nodeBtreeRank(x, h, keystr, keylen, &hit);
+    else i = (want == NODEBTREE_LAST) ? x->count : 0;
+
+    if (x->leaf) {
+      if (want == NODEBTREE_KEY) {
+        if (!hit) break;
+        found = x->items[i];
+      }
+      else {
+        if (want == NODEBTREE_LAST) i--;
+        hole->keys[holeAt] = x->keys[i];
+        hole->items[holeAt] = x->items[i];
+      }
+      x->count--;
+      memmove(x->keys + i, x->keys + i + 1, (x->count - i) * sizeof(uintNN_t));
+      memmove(x->items + i, x->items + i + 1, (x->count - i) * sizeof(node*));
+      break;
+    }
+
+    if (hit) {
+      found = x->items[i];
+      if (x->child[i]->count > NODEBTREE_MIN) {
+        hole = x; holeAt = i; want = NODEBTREE_LAST;
+        x = x->child[i];
+      }
+      else if (x->child[i + 1]->count > NODEBTREE_MIN) {
+        hole = x; holeAt = i; want = NODEBTREE_FIRST;
+        x = x->child[i + 1];
+      }
+      else {
+        nodeBtreeMerge(x, i);   // the key moves down into the merged child
+        x = x->child[i];
+      }
+      continue;
+    }
+
+    if (x->child[i]->count == NODEBTREE_MIN) i = nodeBtreeFill(x, i);
+    x = x->child[i];
+  }
+
+  // A root left without items gives way to its only child (or the tree is empty).
+  nodeBtree* r = (nodeBtree*)root;
+  if (r && r->count == 0) {
+    root = r->leaf ? NULL : r->child[0];
+    dictFree(r, DICT_MEM_INDEX);
+  }
+  return found;
+}
+#endif // _DICT_ENGINE_BTREE
+
+
+#ifdef _DICT_BLOOM
+// ==== BLOOM FILTER =================================================================
+#define NODEBLOOM_BLOCK     64      // bytes per block: one cache line, 128 counters
+#define NODEBLOOM_PROBES    4       // counters per key, 7 bits of hash each
+
+// 64-bit FNV-1a with a final avalanche: the high half picks the block, the low
+// half the counters in it. Independent of the key "crc", which may be a prefix.
+static uint64_t nodeBloomHash(const char* k, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t) k[i];
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+NodeBloom::NodeBloom(size_t init_size) {
+  initialSize = init_size;
+  counters = NULL;
+  mask = 0;
+  items = 0;
+}
+
+NodeBloom::~NodeBloom() {
+  dictFree(counters, DICT_MEM_INDEX);
+  counters = NULL;
+}
+
+void NodeBloom::update(const char* keystr, _DICT_KEY_TYPE keylen, int8_t delta) {
+  uint64_t h = nodeBloomHash(keystr, keylen);
+  uint8_t* b = counters + ((size_t)(h >> 32) & mask) * NODEBLOOM_BLOCK;
+  uint32_t f = (uint32_t) h;
+
+  for (uint8_t i = 0; i < NODEBLOOM_PROBES; i++, f >>= 7) {
+    uint8_t  pos = f & 127;
+    uint8_t  shift = (pos & 1) * 4;
+    uint8_t& c = b[pos >> 1];
+    uint8_t  v = (c >> shift) & 0x0F;
+    if (v == 0x0F) continue;                  // saturated: stays set for good
+    if (delta < 0 && v == 0) continue;        // defensive: never goes below zero
+    v += delta;
+    c = (uint8_t)((c & ~(0x0F << shift)) | (v << shift));
+  }
+}
+
+// Size the filter for the keys of d (_DICT_BLOOM_BITS counters each, and at
+// least the initial size) and count them all. On failure the old filter stays.
+int8_t NodeBloom::rebuild(Dictionary* d) {
+  size_t n = d->count();
+  if (n < initialSize) n = initialSize;
+  size_t blocks = 1;
+  while (blocks * NODEBLOOM_BLOCK * 2 < n * _DICT_BLOOM_BITS) blocks *= 2;
+
+  uint8_t* temp = (uint8_t*)dictAlloc(blocks * NODEBLOOM_BLOCK, DICT_MEM_INDEX);
+  if (temp == NULL) return NODEARRAY_MEM;
+  memset(temp, 0, blocks * NODEBLOOM_BLOCK);
+
+  dictFree(counters, DICT_MEM_INDEX);
+  counters = temp;
+  mask = blocks - 1;
+  items = d->count();
+  for (size_t i = 0; i < items; i++) {
+    const char*     k  = NULL;
+    _DICT_KEY_TYPE  kl = 0;
+    d->entry(i, &k, &kl, NULL, NULL);
+    update(k, kl, 1);
+  }
+  return NODEARRAY_OK;
+}
+
+void NodeBloom::add(const char* keystr, _DICT_KEY_TYPE keylen, Dictionary* d) {
+  if (counters == NULL || (items + 1) * _DICT_BLOOM_BITS > (mask + 1) * NODEBLOOM_BLOCK * 2) {
+    if (rebuild(d) == NODEARRAY_OK) return;   // d already holds this key
+    if (counters == NULL) return;             // no filter: mayContain() says yes
+  }
+  update(keystr, keylen, 1);
+  items++;
+}
+
+void NodeBloom::remove(const char* keystr, _DICT_KEY_TYPE keylen) {
+  if (counters == NULL) return;
+  update(keystr, keylen, -1);
+  items--;
+}
+
+bool NodeBloom::mayContain(const char* keystr, _DICT_KEY_TYPE keylen) {
+  if (counters == NULL) return true;         // no filter (yet)
+  uint64_t       h = nodeBloomHash(keystr, keylen);
+  const uint8_t* b = counters + ((size_t)(h >> 32) & mask) * NODEBLOOM_BLOCK;
+  uint32_t       f = (uint32_t) h;
+
+  for (uint8_t i = 0; i < NODEBLOOM_PROBES; i++, f >>= 7) {
+    uint8_t pos = f & 127;
+    if (((b[pos >> 1] >> ((pos & 1) * 4)) & 0x0F) == 0) return false;
+  }
+  return true;
+}
+#endif // _DICT_BLOOM
+
+
+#ifdef _DICT_FLAT
+// ==== FLAT BLOCK ===================================================================
+// Block sizes are rounded up to 16 bytes, which leaves room for a value to grow a
+// little in place; a block with more spare room than NODEFLAT_SLACK is shrunk.
+#define NODEFLAT_ROUND(n)   (((n) + 15) & ~(size_t)15)
+#define NODEFLAT_SLACK      64
+
+NodeFlat::NodeFlat() {
+  block = NULL;
+  used = 0;
+  cap = 0;
+  items = 0;
+}
+
+NodeFlat::~NodeFlat() {
+  dictFree(block, DICT_MEM_INDEX);
+}
+
+size_t NodeFlat::find(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen) {
+  item* t = table();
+  for (size_t i = 0; i < items; i++) {
+    if (t[i].key != key || t[i].ksize != keylen) continue;
+#ifdef _DICT_HASH_PREFIX
+    // the "crc" is the first 2/4/8 key bytes: only the rest is compared
+    if (keylen <= sizeof(uintNN_t)) return i;
+    if (memcmp(data() + t[i].offset + sizeof(uintNN_t), keystr + sizeof(uintNN_t), keylen - sizeof(uintNN_t)) == 0) return i;
+#else
+    if (memcmp(data() + t[i].offset, keystr, keylen) == 0) return i;
+#endif
+  }
+  return items;
+}
+
+bool NodeFlat::fit(size_t size) {
+  char* b = (char*)dictAlloc(size, DICT_MEM_INDEX);
+  if (b == NULL) return false;
+  if (block) memcpy(b, block, items * sizeof(item) + used);
+  dictFree(block, DICT_MEM_INDEX);
+  block = b;
+  cap = size;
+  return true;
+}
+
+void NodeFlat::shift(size_t from, size_t to) {
+  char* d = data();
+  memmove(d + to, d + from, used - from);
+  item* t = table();
+  for (size_t i = 0; i < items; i++) {
+    if (t[i].offset >= from) t[i].offset = t[i].offset - from + to;
+  }
+  used = used - from + to;
+}
+
+int8_t NodeFlat::put(size_t i, uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen) {
+  size_t vb = vallen + _DICT_EXTRA;
+
+  if (i == items) {     // a new last entry: the data moves up to make room in the table
+    size_t kb = keylen + _DICT_EXTRA;
+    size_t need = (items + 1) * sizeof(item) + used + kb + vb;
+    if (need > cap && !fit(NODEFLAT_ROUND(need))) return NODEARRAY_MEM;
+
+    memmove(block + (items + 1) * sizeof(item), block + items * sizeof(item), used);
+    item* e = table() + items;
+    e->key = key;
+    e->offset = used;
+    e->ksize = keylen;
+    e->vsize = vallen;
+    items++;
+    char* d = data() + used;
+    memcpy(d, keystr, keylen);
+    memcpy(d + kb, valstr, vallen);
+#ifndef _DICT_COMPRESS
+    d[keylen] = 0;
+    d[kb + vallen] = 0;
+#endif
+    used += kb + vb;
+    return NODEARRAY_OK;
+  }
+
+  // A new value for entry i: the bytes after it move to fit its new length.
+  item*  e = table() + i;
+  size_t old = e->vsize + _DICT_EXTRA;
+  size_t need = items * sizeof(item) + used - old + vb;
+  if (need > cap && !fit(NODEFLAT_ROUND(need))) return NODEARRAY_MEM;
+
+  e = table() + i;
+  size_t v = e->offset + e->ksize + _DICT_EXTRA;
+  shift(v + old, v + vb);
+  memcpy(data() + v, valstr, vallen);
+#ifndef _DICT_COMPRESS
+  data()[v + vallen] = 0;
+#endif
+  e->vsize = vallen;
+  if (cap - need > NODEFLAT_SLACK) fit(NODEFLAT_ROUND(need));   // keeps the block on failure
+  return NODEARRAY_OK;
+}
+
+void NodeFlat::remove(size_t i) {
+  item*  t = table();
+  size_t off = t[i].offset;
+  shift(off + t[i].ksize + t[i].vsize + 2 * _DICT_EXTRA, off);
+#ifdef _DICT_ORDERED
+  for (; i + 1 < items; i++) t[i] = t[i + 1];
+#else
+  t[i] = t[items - 1];
+#endif
+  items--;
+  memmove(block + items * sizeof(item), block + (items + 1) * sizeof(item), used);
+
+  if (items == 0) {
+    dictFree(block, DICT_MEM_INDEX);
+    block = NULL;
+    cap = 0;
+    return;
+  }
+  size_t need = items * sizeof(item) + used;
+  if (cap - need > NODEFLAT_SLACK) fit(NODEFLAT_ROUND(need));   // keeps the block on failure
+}
+
+bool NodeFlat::entry(size_t i, const char** k, _DICT_KEY_TYPE* kl, const char** v, _DICT_VAL_TYPE* vl) {
+  if (i >= items) return false;
+  item& e = table()[i];
+  const char* p = data() + e.offset;
+  if (k) *k = p;
+  if (kl) *kl = e.ksize;
+  if (v) *v = p + e.ksize + _DICT_EXTRA;
+  if (vl) *vl = e.vsize;
+  return true;
+}
+#endif // _DICT_FLAT
+
+
+#ifdef _DICT_ARENA
+// ==== ARENA ========================================================================
+NodeArena::NodeArena() {
+  head = NULL;
+  cur = NULL;
+}
+
+NodeArena::~NodeArena() {
+  release();
+}
+
+#ifdef _DICT_ARENA_OFFSETS
+void* NodeArena::alloc(size_t size, _DICT_REF_TYPE* ref) {
+#else
+void* NodeArena::alloc(size_t size) {
+#endif
+  size = (size + _DICT_NODE_ALIGN - 1) & ~(size_t)(_DICT_NODE_ALIGN - 1);
+
+  // Bump within the current chunk, then within the chunks kept by reset().
+  while (cur) {
+    if (cur->cap - cur->used >= size) {
+      void* p = (char*)cur + HEADER + cur->used;
+#ifdef _DICT_ARENA_OFFSETS
+      *ref = (_DICT_REF_TYPE)((cur->id << OFFSET_BITS) | ((HEADER + cur->used) >> 3));
+#endif
+      cur->used += size;
+      return p;
+    }
+    if (!cur->next) break;
+    cur = cur->next;
+    cur->used = 0;
+  }
+
+#ifdef _DICT_ARENA_OFFSETS
+  // Every chunk has the same size, so that an offset fits in OFFSET_BITS.
+  static_assert(sizeof(node) + sizeof(uintNN_t) + _DICT_KEYLEN + _DICT_VALLEN + 2 * _DICT_EXTRA + _DICT_NODE_ALIGN <= _DICT_ARENA_CHUNK - HEADER,
+                "_DICT_ARENA_CHUNK is too small for an entry with the longest key and value");
+  size_t cap = _DICT_ARENA_CHUNK - HEADER;
+  if (size > cap) return NULL;
+#else
+  size_t cap = size > _DICT_ARENA_CHUNK ? size : _DICT_ARENA_CHUNK;
+#endif
+  chunk* c = (chunk*)dictAlloc(HEADER + cap, DICT_MEM_NODE);
+  if (!c) return NULL;
+#ifdef _DICT_ARENA_OFFSETS
+  c->id = enroll(c);
+  if (c->id == 0) {
+    dictFree(c, DICT_MEM_NODE);
+    return NULL;
+  }
+  *ref = (_DICT_REF_TYPE)((c->id << OFFSET_BITS) | (HEADER >> 3));
+#endif
+
+  c->next = NULL;
+  c->cap = cap;
+  c->used = size;
+  if (cur) cur->next = c;
+  else     head = c;
+  cur = c;
+  return (char*)c + HEADER;
+}
+
+// O(1): the other chunks are rewound as alloc() reaches them.
+void NodeArena::reset() {
+  cur = head;
+  if (cur) cur->used = 0;
+}
+
+void NodeArena::release() {
+  while (head) {
+    chunk* c = head->next;
+#ifdef _DICT_ARENA_OFFSETS
+    retire(head->id);
+#endif
+    dictFree(head, DICT_MEM_NODE);
+    head = c;
+  }
+  cur = NULL;
+}
+
+#ifdef _DICT_ARENA_OFFSETS
+// Number 0 is the NULL handle: the directory starts out as just that entry, and
+// goes back to it when the last chunk is released.
+static char*  nodeArenaNoChunks[1] = { NULL };
+
+char**    NodeArena::dir = nodeArenaNoChunks;
+uint32_t  NodeArena::dirSize = 1;
+uint32_t  NodeArena::dirCap = 1;
+uint32_t  NodeArena::dirFree = 0;
+uint32_t  NodeArena::dirLive = 0;
+
+uint32_t NodeArena::enroll(chunk* c) {
+  uint32_t id = dirFree;
+  if (id) {
+    dirFree = (uint32_t)(uintptr_t)dir[id];
+  }
   else {
-    int8_t rc;
+    if (dirSize > MAX_ID) return 0;
+    if (dirSize == dirCap) {
+      uint32_t cap = dirCap * 2 < 16 ? 16 : dirCap * 2;
+      char** d = (char**)dictAlloc(cap * sizeof(char*), DICT_MEM_INDEX);
+      if (!d) return 0;
+      memcpy(d, dir, dirSize * sizeof(char*));
+      if (dir != nodeArenaNoChunks) dictFree(dir, DICT_MEM_INDEX);
+      dir = d;
+      dirCap = cap;
+    }
+    id = dirSize++;
+  }
+  dir[id] = (char*)c;
+  dirLive++;
+  return id;
+}
+
+void NodeArena::retire(uint32_t id) {
+  dir[id] = (char*)(uintptr_t)dirFree;
+  dirFree = id;
+  if (--dirLive == 0) {
+    dictFree(dir, DICT_MEM_INDEX);
+    dir = nodeArenaNoChunks;
+    dirSize = dirCap = 1;
+    dirFree = 0;
+  }
+}
 
-    iRoot = new node;
-    if (!iRoot) return DICTIONARY_MEM;
-    rc = iRoot->create(iKeyTemp, iKeyLen, iValTemp, iValLen, NULL, NULL);
+#ifdef _DICT_ENGINE_TREE
+inline nodeRef& nodeRef::operator = (node* n) {
+  h = n ? n->self : 0;
+  return *this;
+}
 
-#ifdef _LIBDEBUG_
-    Serial.printf("DICT-insert: creating root entry. rc = %d\n", rc);
+inline nodeRef::operator node* () const {
+  return (node*)NodeArena::address(h);
+}
+
+inline node* nodeRef::operator -> () const {
+  return (node*)NodeArena::address(h);
+}
 #endif
 
-    if (rc) {
-      delete iRoot;
-      iRoot = NULL;   // must not leave a dangling root - the next insert reads it
-      return rc;
+inline char* node::vbuf() const {
+  if ( vref ) return (char*)NodeArena::address(vref);
+  return kbuf() + (ksize < sizeof(uintNN_t) ? sizeof(uintNN_t) : ksize) + _DICT_EXTRA;
+}
+#endif // _DICT_ARENA_OFFSETS
+#endif // _DICT_ARENA
+
+
+#ifdef _DICT_SLAB
+// ==== SLAB =========================================================================
+NodeSlab::NodeSlab() {
+  for (uint8_t c = 0; c < CLASSES; c++) {
+    freeList[c] = NULL;
+    carve[c] = NULL;
+    left[c] = 0;
+  }
+  pages = NULL;
+}
+
+NodeSlab::~NodeSlab() {
+  clear();
+}
+
+size_t NodeSlab::objectSize(uint8_t c) {
+  if (c == 0) return (sizeof(node) + 7) & ~(size_t)7;   // keeps the nodes aligned
+  return (size_t)8 << (c - 1);
+}
+
+uint8_t NodeSlab::sizeClass(size_t size) {
+  uint8_t c = 1;
+  while (objectSize(c) < size) c++;
+  return c;
+}
+
+size_t NodeSlab::capacity(size_t size) {
+  return size > LARGEST ? size : objectSize(sizeClass(size));
+}
+
+void* NodeSlab::take(uint8_t c) {
+  void* p = freeList[c];
+  if (p) {
+    memcpy(&freeList[c], p, sizeof(void*));
+    return p;
+  }
+
+  size_t sz = objectSize(c);
+  if (left[c] == 0) {
+    // A new page: the link to the previous one, padded to 8 bytes, then objects.
+    size_t n = (_DICT_SLAB_PAGE - 8) / sz;
+    if (n == 0) n = 1;
+    char* pg = (char*)dictAlloc(8 + n * sz, DICT_MEM_NODE);
+    if (!pg) return NULL;
+
+    memcpy(pg, &pages, sizeof(char*));
+    pages = pg;
+    carve[c] = pg + 8;
+    left[c] = n;
+  }
+  p = carve[c];
+  carve[c] += sz;
+  left[c]--;
+  return p;
+}
+
+void NodeSlab::give(void* p, uint8_t c) {
+  memcpy(p, &freeList[c], sizeof(void*));
+  freeList[c] = p;
+}
+
+void* NodeSlab::alloc(size_t size, uint8_t region) {
+  if (size <= LARGEST) return take(sizeClass(size));
+  return dictAlloc(size, region);
+}
+
+void NodeSlab::release(void* p, size_t size, uint8_t region) {
+  if (p == NULL) return;
+  if (size <= LARGEST) give(p, sizeClass(size));
+  else                 dictFree(p, region);
+}
+
+node* NodeSlab::allocNode() {
+  return (node*)take(0);
+}
+
+void NodeSlab::releaseNode(node* n) {
+  give(n, 0);
+}
+
+void NodeSlab::clear() {
+  while (pages) {
+    char* next;
+    memcpy(&next, pages, sizeof(char*));
+    dictFree(pages, DICT_MEM_NODE);
+    pages = next;
+  }
+  for (uint8_t c = 0; c < CLASSES; c++) {
+    freeList[c] = NULL;
+    carve[c] = NULL;
+    left[c] = 0;
+  }
+}
+#endif // _DICT_SLAB
+
+
+// ==== FROZEN INDEX =================================================================
+#define FROZENINDEX_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+FrozenIndex::FrozenIndex() {
+  block = NULL;
+#ifdef _DICT_FREEZE_MPH
+  disp = NULL;
+  buckets = 0;
+  seed = 0;
+#else
+  keys = NULL;
+#endif
+  order = NULL;
+  list = NULL;
+  data = NULL;
+  items = 0;
+  bytes = 0;
+}
+
+FrozenIndex::~FrozenIndex() {
+  dictFree(block, DICT_MEM_INDEX);
+  block = NULL;
+}
+
+int8_t FrozenIndex::build(Dictionary* d) {
+  size_t n = d->count();
+  if (n == 0) return NODEARRAY_OK;
+
+  size_t dsize = 0;
+  for (size_t i = 0; i < n; i++) {
+    _DICT_KEY_TYPE kl;
+    _DICT_VAL_TYPE vl;
+    d->entry(i, NULL, &kl, NULL, &vl);
+    dsize += kl + vl + 2 * _DICT_EXTRA;
+  }
+
+#ifdef _DICT_FREEZE_MPH
+  size_t nb = (n + _DICT_FREEZE_BUCKET - 1) / _DICT_FREEZE_BUCKET;
+  size_t ibytes = FROZENINDEX_ALIGN(sizeof(uint32_t) * nb);
+#else
+  size_t ibytes = FROZENINDEX_ALIGN(sizeof(uintNN_t) * (n + 1));
+#endif
+  size_t obytes = FROZENINDEX_ALIGN(sizeof(uint32_t) * (n + 1));
+  size_t lbytes = FROZENINDEX_ALIGN(sizeof(item) * n);
+  size_t total = ibytes + obytes + lbytes + dsize;
+
+  char* b = (char*)dictAlloc(total, DICT_MEM_INDEX);
+  if (b == NULL) return NODEARRAY_MEM;
+
+  block = b;
+#ifdef _DICT_FREEZE_MPH
+  disp = (uint32_t*) b;
+  buckets = nb;
+#else
+  keys = (uintNN_t*) b;
+#endif
+  order = (uint32_t*) (b + ibytes);
+  list = (item*) (b + ibytes + obytes);
+  data = b + ibytes + obytes + lbytes;
+  items = n;
+  bytes = total;
+
+  // Data area and entry list in positional order.
+  uint32_t off = 0;
+  for (size_t i = 0; i < n; i++) {
+    const char*     k  = NULL;
+    _DICT_KEY_TYPE  kl = 0;
+    const char*     v  = NULL;
+    _DICT_VAL_TYPE  vl = 0;
+    d->entry(i, &k, &kl, &v, &vl);
+    list[i].offset = off;
+    list[i].ksize = kl;
+    list[i].vsize = vl;
+    memcpy(data + off, k, kl + _DICT_EXTRA);
+    off += kl + _DICT_EXTRA;
+    memcpy(data + off, v, vl + _DICT_EXTRA);
+    off += vl + _DICT_EXTRA;
+  }
+
+  int8_t rc = index();
+  if (rc) {
+    dictFree(block, DICT_MEM_INDEX);
+    block = NULL;
+    items = 0;
+    bytes = 0;
+  }
+  return rc;
+}
+
+bool FrozenIndex::entry(size_t i, const char** k, _DICT_KEY_TYPE* kl, const char** v, _DICT_VAL_TYPE* vl) {
+  if (i >= items) return false;
+  const item& it = list[i];
+  if (k) *k = data + it.offset;
+  if (kl) *kl = it.ksize;
+  if (v) *v = data + it.offset + it.ksize + _DICT_EXTRA;
+  if (vl) *vl = it.vsize;
+  return true;
+}
+
+#ifndef _DICT_FREEZE_MPH
+// ---- Eytzinger layout ----
+// Key hashes per 64-byte cache line: keys[16k..16k+15] (32-bit hashes) are the 4th
+// level below k, so one prefetch covers the next four steps of the descent.
+#define FROZENINDEX_LINE    (64 / sizeof(uintNN_t))
+
+// Key order of the index: hash, then length, then bytes (same as the tree).
+static int frozenIndexCompare(uintNN_t h1, const char* k1, _DICT_KEY_TYPE l1, uintNN_t h2, const char* k2, _DICT_KEY_TYPE l2) {
+  if (h1 != h2) return h1 < h2 ? -1 : 1;
+  if (l1 != l2) return l1 < l2 ? -1 : 1;
+  return memcmp(k1, k2, l1);
+}
+
+struct frozenIndexSort {
+  uintNN_t        h;
+  const char*     k;
+  uint32_t        pos;
+  _DICT_KEY_TYPE  kl;
+};
+
+static int frozenIndexSortCompare(const void* a, const void* b) {
+  const frozenIndexSort* x = (const frozenIndexSort*) a;
+  const frozenIndexSort* y = (const frozenIndexSort*) b;
+  return frozenIndexCompare(x->h, x->k, x->kl, y->h, y->k, y->kl);
+}
+
+int8_t FrozenIndex::index() {
+  size_t n = items;
+
+  // Temporary sort buffer, released before returning either way.
+  frozenIndexSort* s = (frozenIndexSort*) dictAlloc(sizeof(frozenIndexSort) * n, DICT_MEM_INDEX);
+  if (s == NULL) return NODEARRAY_MEM;
+
+  for (size_t i = 0; i < n; i++) {
+    s[i].k = data + list[i].offset;
+    s[i].kl = list[i].ksize;
+    s[i].h = Dictionary::crc(s[i].k, s[i].kl);
+    s[i].pos = (uint32_t) i;
+  }
+  qsort(s, n, sizeof(frozenIndexSort), frozenIndexSortCompare);
+
+  // Lay the sorted keys out in Eytzinger order with an in-order walk of the
+  // implicit tree (children of k are 2k and 2k+1), starting at the leftmost node.
+  size_t k = 1;
+  while (2 * k <= n) k *= 2;
+  for (size_t i = 0; i < n; i++) {
+    keys[k] = s[i].h;
+    order[k] = s[i].pos;
+    if (2 * k + 1 <= n) {
+      k = 2 * k + 1;
+      while (2 * k <= n) k *= 2;
     }
-    rc = Q->append(iRoot);
-    if (rc) {
-      delete iRoot;
-      iRoot = NULL;   // ditto: append failed, so the root is not tracked
-      return rc;
+    else {
+      while (k & 1) k >>= 1;    // climb out of right subtrees...
+      k >>= 1;                  // ...to the first ancestor we are left of
+    }
+  }
+  keys[0] = 0;
+  order[0] = 0;
+
+  dictFree(s, DICT_MEM_INDEX);
+  return NODEARRAY_OK;
+}
+
+size_t FrozenIndex::find(const char* keystr, _DICT_KEY_TYPE keylen) {
+  uintNN_t h = Dictionary::crc(keystr, keylen);
+  size_t k = 1;
+
+  // Descend to a leaf, going right while the slot is less than the key; the
+  // comparison result is the next index bit, not a branch.
+  while (k <= items) {
+#if defined(__GNUC__)
+    __builtin_prefetch(keys + k * FROZENINDEX_LINE);
+#endif
+    uintNN_t e = keys[k];
+    bool less = e < h;
+    if (e == h) {
+      const item& it = list[order[k]];
+      less = frozenIndexCompare(e, data + it.offset, it.ksize, h, keystr, keylen) < 0;
+    }
+    k = 2 * k + less;
+  }
+  // The lower bound is where the path last went left: drop the trailing right
+  // turns and that left turn.
+  while (k & 1) k >>= 1;
+  k >>= 1;
+
+  if (k == 0 || keys[k] != h) return items;
+  const item& it = list[order[k]];
+  if (it.ksize != keylen || memcmp(data + it.offset, keystr, keylen) != 0) return items;
+  return order[k];
+}
+
+#else
+// ---- Minimal perfect hash (CHD: compress, hash and displace) ----
+// A key's 64-bit hash picks a bucket (high half) and a slot hash f (low half).
+// Each bucket stores one displacement d so that mix(f ^ d * golden) % n puts all of
+// its keys on free slots; buckets are placed largest first. Single-key buckets
+// are placed last, straight into the remaining slots (FROZENINDEX_DIRECT | slot).
+#define FROZENINDEX_DIRECT  0x80000000UL
+#define FROZENINDEX_MAXDISP (1UL << 20)   // displacements tried per bucket
+#define FROZENINDEX_SEEDS   16            // whole-build retries with a new hash seed
+#define FROZENINDEX_GOLDEN  0x9E3779B9UL
+
+#define FROZENINDEX_TAKEN(m, i)   ((m)[(i) >> 3] & (1 << ((i) & 7)))
+#define FROZENINDEX_TAKE(m, i)    ((m)[(i) >> 3] |= (1 << ((i) & 7)))
+#define FROZENINDEX_RELEASE(m, i) ((m)[(i) >> 3] &= ~(1 << ((i) & 7)))
+
+// Seeded 64-bit FNV-1a with a final avalanche, so both halves are usable.
+static uint64_t frozenIndexHash(uint32_t seed, const char* k, size_t len) {
+  uint64_t h = 14695981039346656037ULL ^ seed;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t) k[i];
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static inline uint32_t frozenIndexMix(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x85ebca6bUL;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35UL;
+  x ^= x >> 16;
+  return x;
+}
+
+static inline size_t frozenIndexSlot(uint32_t d, uint32_t f, size_t n) {
+  if (d & FROZENINDEX_DIRECT) return d & ~FROZENINDEX_DIRECT;
+  return frozenIndexMix(f ^ (uint32_t)(d * FROZENINDEX_GOLDEN)) % n;
+}
+
+int8_t FrozenIndex::index() {
+  size_t n = items;
+  size_t r = buckets;
+
+  // Temporary build state, released before returning either way: per-key bucket
+  // and slot hash, keys grouped by bucket, bucket starts, a scratch array and
+  // the slot occupancy bitmap.
+  uint32_t* hb = (uint32_t*) dictAlloc(sizeof(uint32_t) * (4 * n + r + 1) + (n + 7) / 8, DICT_MEM_INDEX);
+  if (hb == NULL) return NODEARRAY_MEM;
+  uint32_t* hf = hb + n;
+  uint32_t* members = hf + n;
+  uint32_t* scratch = members + n;
+  uint32_t* start = scratch + n;
+  uint8_t*  taken = (uint8_t*)(start + r + 1);
+
+  for (uint32_t attempt = 0; attempt < FROZENINDEX_SEEDS; attempt++) {
+    seed = attempt * FROZENINDEX_GOLDEN;
+    for (size_t i = 0; i < n; i++) {
+      uint64_t h = frozenIndexHash(seed, data + list[i].offset, list[i].ksize);
+      hb[i] = (uint32_t)((uint32_t)(h >> 32) % r);
+      hf[i] = (uint32_t) h;
+    }
+
+    // Group keys by bucket (counting sort); scratch holds the fill cursors.
+    memset(start, 0, sizeof(uint32_t) * (r + 1));
+    for (size_t i = 0; i < n; i++) start[hb[i] + 1]++;
+    size_t largest = 0;
+    for (size_t b = 0; b < r; b++) {
+      if (start[b + 1] > largest) largest = start[b + 1];
+      start[b + 1] += start[b];
+    }
+    memcpy(scratch, start, sizeof(uint32_t) * r);
+    for (size_t i = 0; i < n; i++) members[scratch[hb[i]]++] = (uint32_t) i;
+
+    // Displace multi-key buckets, largest first; scratch now holds the slots
+    // of the bucket being placed so a failed displacement can be undone.
+    memset(taken, 0, (n + 7) / 8);
+    bool ok = true;
+    for (size_t sz = largest; sz >= 2 && ok; sz--) {
+      for (size_t b = 0; b < r && ok; b++) {
+        if (start[b + 1] - start[b] != sz) continue;
+        uint32_t d;
+        for (d = 0; d < FROZENINDEX_MAXDISP; d++) {
+          size_t j;
+          for (j = 0; j < sz; j++) {
+            size_t s = frozenIndexSlot(d, hf[members[start[b] + j]], n);
+            if (FROZENINDEX_TAKEN(taken, s)) break;
+            FROZENINDEX_TAKE(taken, s);
+            scratch[j] = (uint32_t) s;
+          }
+          if (j == sz) break;
+          while (j) {
+            j--;
+            FROZENINDEX_RELEASE(taken, scratch[j]);
+          }
+        }
+        if (d == FROZENINDEX_MAXDISP) ok = false;
+        disp[b] = d;
+      }
+    }
+    if (!ok) continue;
+
+    // Single-key buckets take the free slots directly; empty buckets keep 0.
+    size_t s = 0;
+    for (size_t b = 0; b < r; b++) {
+      if (start[b + 1] - start[b] != 1) {
+        if (start[b + 1] == start[b]) disp[b] = 0;
+        continue;
+      }
+      while (FROZENINDEX_TAKEN(taken, s)) s++;
+      FROZENINDEX_TAKE(taken, s);
+      disp[b] = FROZENINDEX_DIRECT | (uint32_t) s;
     }
+
+    for (size_t i = 0; i < n; i++) order[frozenIndexSlot(disp[hb[i]], hf[i], n)] = (uint32_t) i;
+    dictFree(hb, DICT_MEM_INDEX);
+    return NODEARRAY_OK;
   }
-  return DICTIONARY_OK;
+  dictFree(hb, DICT_MEM_INDEX);
+  return NODEARRAY_ERR;   // no seed gave a perfect hash (e.g. a full 64-bit collision)
+}
+
+size_t FrozenIndex::find(const char* keystr, _DICT_KEY_TYPE keylen) {
+  if (items == 0) return 0;
+
+  uint64_t h = frozenIndexHash(seed, keystr, keylen);
+  uint32_t d = disp[(uint32_t)(h >> 32) % buckets];
+  size_t   i = order[frozenIndexSlot(d, (uint32_t) h, items)];
+
+  const item& it = list[i];
+  if (it.ksize != keylen || memcmp(data + it.offset, keystr, keylen) != 0) return items;
+  return i;
+}
+#endif // _DICT_FREEZE_MPH
+
+
+
+// ==== CONSTRUCTOR / DESTRUCTOR ==================================
+Dictionary::Dictionary(size_t init_size) {
+#ifdef _DICT_ENGINE_TREE
+  iRoot = NULL;
+#endif
+
+  // This is unlikely to fail as practically no memory is allocated by the NodeArray
+  // All memory allocation is delegated to the first append
+  Q = new NodeArray(init_size);
+  F = NULL;
+#ifdef _DICT_FLAT
+  L = new NodeFlat;                // the block is allocated on first insert
+#endif
+#ifdef _DICT_ENGINE_HASH
+  H = new NodeHash(init_size);     // the table is allocated on first insert
+#endif
+#ifdef _DICT_ENGINE_SWISS
+  H = new NodeSwiss(init_size);
+#endif
+#ifdef _DICT_ENGINE_ART
+  H = new NodeArt(init_size);      // inner nodes are allocated as keys arrive
+#endif
+#ifdef _DICT_ENGINE_BTREE
+  H = new NodeBtree(init_size);    // the root is allocated on first insert
+#endif
+#ifdef _DICT_BLOOM
+  B = new NodeBloom(init_size);    // the counters are allocated on first insert
+#endif
+#ifdef _DICT_ARENA
+  A = new NodeArena;               // the first chunk is allocated on first insert
+#endif
+#ifdef _DICT_SLAB
+  S = new NodeSlab;                // pages are allocated as the classes fill up
+#endif
+#ifdef _DICT_TIERS
+  iTierRng = 1;
+#endif
+  initSize = init_size;
+
+#ifdef _DICT_COMPRESS
+  // This however is a problem - need to think about a safer way
+  iKeyTemp = (char*) dictAlloc(sizeof(char) * (_DICT_KEYLEN + 1), DICT_MEM_INDEX);
+  iValTemp = (char*) dictAlloc(sizeof(char) * (_DICT_VALLEN + 1), DICT_MEM_INDEX);
+#else
+  iKeyTemp = NULL;
+  iValTemp = NULL;
+#endif
+}
+
+Dictionary::~Dictionary() {
+  destroy();
+  delete Q;
+#ifdef _DICT_FLAT
+  delete L;
+#endif
+#ifdef _DICT_INDEX_EXTERNAL
+  delete H;
+#endif
+#ifdef _DICT_BLOOM
+  delete B;
+#endif
+#ifdef _DICT_ARENA
+  delete A;
+#endif
+#ifdef _DICT_SLAB
+  delete S;
+#endif
+#ifdef _DICT_COMPRESS
+  dictFree(iKeyTemp, DICT_MEM_INDEX); iKeyTemp = NULL;
+  dictFree(iValTemp, DICT_MEM_INDEX); iValTemp = NULL;
+#endif
+}
+
+
+
+// ==== PUBLIC METHODS ===============================================
+
+// ===== INSERTS =====================================================
+
+int8_t Dictionary::insert(const char* keystr, const char* valstr) {
+  if (F) return DICTIONARY_ERR;   // frozen: read-only
+  // TODO: decide if to check for length here
+  iKeyLen = strnlen(keystr, _DICT_KEYLEN + 1);
+#ifdef _DICT_COMPRESS
+  int8_t rc;
+#endif
+
+  if ( iKeyLen == 0 || iKeyLen > _DICT_KEYLEN ) return DICTIONARY_ERR;
+  if ( (iValLen = strnlen(valstr, _DICT_VALLEN + 1)) > _DICT_VALLEN ) return DICTIONARY_ERR;
+
+#ifdef _DICT_COMPRESS
+  if ( (rc = compressKey(keystr)) ) return rc;
+  if ( (rc = compressValue(valstr)) ) return rc;
+#else
+  iKeyTemp = (char*) keystr;
+  iValTemp = (char*) valstr;
+#endif
+
+  uintNN_t key = crc(iKeyTemp, iKeyLen);
+
+#ifdef _DICT_BLOOM
+  size_t ct = count();
+  int8_t res = insert(key, iKeyTemp, iKeyLen, iValTemp, iValLen);
+  if (count() > ct) B->add(iKeyTemp, iKeyLen, this);   // a new key, not an update
+  return res;
+#else
+  return insert(key, iKeyTemp, iKeyLen, iValTemp, iValLen);
+#endif
 }
 
 
@@ -521,66 +2696,194 @@ String Dictionary::search(const char* keystr) {
 #else
         iKeyTemp = (char*) keystr;
 #endif
-        uintNN_t key = crc(iKeyTemp, iKeyLen);
-
-        node* p = search(key, iRoot, iKeyTemp, iKeyLen);
-        if (p) {
+        if (F) {
+            size_t i = F->find(iKeyTemp, iKeyLen);
+            if (i < F->count()) return value(i);
+        }
+#ifdef _DICT_BLOOM
+        else if (!B->mayContain(iKeyTemp, iKeyLen)) {
+            return String("");
+        }
+#endif
+#ifdef _DICT_FLAT
+        else if (L) {
+            size_t i = L->find(crc(iKeyTemp, iKeyLen), iKeyTemp, iKeyLen);
+            if (i < L->count()) return value(i);
+        }
+#endif
+        else {
+            uintNN_t key = crc(iKeyTemp, iKeyLen);
+            node* p = search(key, iKeyTemp, iKeyLen);
+            if (p) {
+#ifdef _DICT_TIERS
+                iTierRng = iTierRng * 1664525u + 1013904223u;   // LCG: use the high bits
+                if ( ((iTierRng >> 24) & (_DICT_TIERS_SAMPLE - 1)) == 0 && p->hits < 255 ) p->hits++;
+#endif
 #ifdef _DICT_COMPRESS
-            decompressValue(p->valbuf, p->vsize);
-            return String(iValTemp);
+                decompressValue(p->vbuf(), p->vsize);
+                return String(iValTemp);
 #else
-            return String(p->valbuf);   // buffer is kept NUL-terminated at write time
+                return String(p->vbuf());   // buffer is kept NUL-terminated at write time
 #endif
+            }
         }
     }
     return String("");
 }
 
 String Dictionary::key(size_t i) {
-  if (Q) {
-    node* p = (*Q)[i];
-    if (p) {
+  const char*     k;
+  _DICT_KEY_TYPE  kl;
+
+  if (entry(i, &k, &kl, NULL, NULL)) {
 #ifdef _DICT_COMPRESS
-        decompressKey(p->keybuf, p->ksize);
-        return String(iKeyTemp);
+      decompressKey(k, kl);
+      return String(iKeyTemp);
 #else
-        return String(p->keybuf);   // buffer is kept NUL-terminated at write time
+      return String(k);   // buffer is kept NUL-terminated at write time
 #endif
-    }
   }
   return String();
 }
 
 String Dictionary::value(size_t i) {
-    if (Q) {
-        node* p = (*Q)[i];
-        if (p) {
+    const char*     v;
+    _DICT_VAL_TYPE  vl;
+
+    if (entry(i, NULL, NULL, &v, &vl)) {
 #ifdef _LIBDEBUG_
     Serial.printf("Dictionary::value:\n");
-    Serial.printf("\tFound ptr = %u (%u:%d)\n", (uint32_t)p, (uint32_t)p->valbuf, p->vsize);
+    Serial.printf("\tFound ptr = %u (%d)\n", (uint32_t)v, vl);
 #endif
 #ifdef _DICT_COMPRESS
-            decompressValue(p->valbuf, p->vsize);
-            return String(iValTemp);
+        decompressValue(v, vl);
+        return String(iValTemp);
 #else
-            return String(p->valbuf);   // buffer is kept NUL-terminated at write time
+        return String(v);   // buffer is kept NUL-terminated at write time
 #endif
-        }
     }
     return String();
 }
 
+String DictionaryIterator::key() {
+    return iDict->key(iPos);
+}
+
+String DictionaryIterator::value() {
+    return iDict->value(iPos);
+}
+
+size_t Dictionary::forEachPrefix(const char* prefix, DictionaryCallback cb, void* ctx) {
+    size_t plen = strnlen(prefix, _DICT_KEYLEN + 1);
+    size_t found = 0;
+
+#if defined(_DICT_ENGINE_ART) && !defined(_DICT_COMPRESS)
+#ifdef _DICT_FLAT
+    if (!F && !L) {
+#else
+    if (!F) {
+#endif
+        found = H->forEachPrefix(prefix, plen, cb, ctx);
+        if (found != (size_t)-1) return found;
+        found = 0;    // no memory for the walk - scan instead
+    }
+#endif
+    // Other engines, frozen or flat dictionaries and compressed keys (whose stored bytes
+    // do not keep the prefix) test every key.
+    size_t ct = count();
+    for (size_t i = 0; i < ct; i++) {
+#ifdef _DICT_COMPRESS
+        String k = key(i);
+        if (k.length() < plen || strncmp(k.c_str(), prefix, plen) != 0) continue;
+        cb(k, value(i), ctx);
+#else
+        const char*     k;
+        _DICT_KEY_TYPE  kl;
+        const char*     v;
+        entry(i, &k, &kl, &v, NULL);
+        if (kl < plen || memcmp(k, prefix, plen) != 0) continue;
+        cb(String(k), String(v), ctx);
+#endif
+        found++;
+    }
+    return found;
+}
+
+bool Dictionary::entry(size_t i, const char** k, _DICT_KEY_TYPE* kl, const char** v, _DICT_VAL_TYPE* vl) {
+    if (F) return F->entry(i, k, kl, v, vl);
+#ifdef _DICT_FLAT
+    if (L) return L->entry(i, k, kl, v, vl);
+#endif
+
+    node* p = Q ? (*Q)[i] : NULL;
+    if (p == NULL) return false;
+    if (k) *k = p->kbuf();
+    if (kl) *kl = p->ksize;
+    if (v) *v = p->vbuf();
+    if (vl) *vl = p->vsize;
+    return true;
+}
+
 
 // ==== DELETES =====================================================
 void Dictionary::destroy() {
     // Q references every node exactly once, so free them by walking the flat
     // array instead of recursing the tree (which could overflow the stack on a
     // degenerate/unbalanced tree).
+    delete F;
+    F = NULL;
     size_t ct = Q ? Q->count() : 0;
-    for (size_t i = 0; i < ct; i++) delete (*Q)[i];
+#ifdef _DICT_ARENA
+    ct = 0;     // the nodes and their strings go back to the arena in one step
+#endif
+#if defined(_DICT_SLAB) && _DICT_KEYLEN + _DICT_EXTRA <= 256 && _DICT_VALLEN + _DICT_EXTRA <= 256
+    ct = 0;     // every node and string is in the slab's pages, freed below
+#endif
+#ifdef _DICT_ORDERED
+    // The list is read through the nodes: take each off the front before freeing it.
+    for (; ct; ct--) {
+        node* p = (*Q)[0];
+        Q->remove(p);
+        freeNode(p);
+    }
+#else
+    for (size_t i = 0; i < ct; i++) freeNode((*Q)[i]);
+#endif
+#ifdef _DICT_ARENA
+    A->reset();
+#endif
+#ifdef _DICT_SLAB
+    S->clear();
+#endif
+#ifdef _DICT_ENGINE_TREE
     iRoot = NULL;
+#endif
+#ifdef _DICT_ENGINE_HASH
+    delete H;
+    H = new NodeHash(initSize);
+#endif
+#ifdef _DICT_ENGINE_SWISS
+    delete H;
+    H = new NodeSwiss(initSize);
+#endif
+#ifdef _DICT_ENGINE_ART
+    delete H;
+    H = new NodeArt(initSize);
+#endif
+#ifdef _DICT_ENGINE_BTREE
+    delete H;
+    H = new NodeBtree(initSize);
+#endif
+#ifdef _DICT_BLOOM
+    delete B;
+    B = new NodeBloom(initSize);
+#endif
     delete Q;
     Q = new NodeArray(initSize);
+#ifdef _DICT_FLAT
+    delete L;
+    L = new NodeFlat;
+#endif
 }
 
 int8_t Dictionary::remove(const String& keystr) {
@@ -594,6 +2897,7 @@ int8_t Dictionary::remove(const char* keystr) {
 #ifdef _DICT_COMPRESS
     int8_t rc;
 #endif
+    if (F) return DICTIONARY_ERR;   // frozen: read-only
     iKeyLen = strnlen(keystr, _DICT_KEYLEN + 1);
     if (iKeyLen > _DICT_KEYLEN) return DICTIONARY_ERR;
 
@@ -604,25 +2908,26 @@ int8_t Dictionary::remove(const char* keystr) {
 #endif
 
     uintNN_t key = crc(iKeyTemp, iKeyLen);
-    node* p = search(key, iRoot, iKeyTemp, iKeyLen);
 
-    if (p) {
-#ifdef _LIBDEBUG_
-        Serial.printf("Found key to delete int: %u\n", p->key());
-        Serial.printf("Found key to delete ptr: %u\n", (uint32_t)p);
-//        Serial.printf("Found key to delete str: %s\n", keystr);
+#ifdef _DICT_BLOOM
+    if (!B->mayContain(iKeyTemp, iKeyLen)) return DICTIONARY_OK;
+    size_t ct = count();
+    int8_t res = deleteNode(key, iKeyTemp, iKeyLen);
+    if (count() < ct) B->remove(iKeyTemp, iKeyLen);
+    return res;
+#else
+    return deleteNode(key, iKeyTemp, iKeyLen);
 #endif
-        iError = DICTIONARY_OK;
-        iRoot = deleteNode(iRoot, p->key(), iKeyTemp, iKeyLen);
-        if (iError != DICTIONARY_OK) return iError;   // e.g. OOM while promoting the successor
-    }
-    return DICTIONARY_OK;
 }
 
 
 // ==== SIZES ============================================================================
 // This is the size of the Dictionary in memory (just data, not object)
 size_t Dictionary::size() {
+    if (F) return F->size();
+#ifdef _DICT_FLAT
+    if (L) return L->size();
+#endif
     size_t ct = count();
     size_t sz = 0;
     for (size_t i = 0; i < ct; i++) {
@@ -645,9 +2950,11 @@ size_t Dictionary::jsize() {
         sz += key(i).length();    // stored compressed - must decompress to measure
         sz += value(i).length();
 #else
-        node* p = (*Q)[i];        // stored verbatim - ksize/vsize are the string lengths
-        sz += p->ksize;
-        sz += p->vsize;
+        _DICT_KEY_TYPE kl = 0;    // stored verbatim - ksize/vsize are the string lengths
+        _DICT_VAL_TYPE vl = 0;
+        entry(i, NULL, &kl, NULL, &vl);
+        sz += kl;
+        sz += vl;
 #endif
     }
     return sz;
@@ -663,9 +2970,11 @@ size_t Dictionary::esize() {
         sz += key(i).length() + 1;
         sz += value(i).length() + 1;
 #else
-        node* p = (*Q)[i];
-        sz += p->ksize + 1;
-        sz += p->vsize + 1;
+        _DICT_KEY_TYPE kl = 0;
+        _DICT_VAL_TYPE vl = 0;
+        entry(i, NULL, &kl, NULL, &vl);
+        sz += kl + 1;
+        sz += vl + 1;
 #endif
     }
     return sz;
@@ -713,6 +3022,8 @@ int8_t Dictionary::jload(Stream& json, int aNum) {
     String currentKey;
     String currentValue;
 
+    if (F) return DICTIONARY_ERR;   // frozen: read-only
+
     while ( json.peek() >= 0 ) {
         char c = json.read();
 
@@ -818,6 +3129,91 @@ int8_t Dictionary::merge(Dictionary& dict) {
     return DICTIONARY_OK;
 }
 
+// ==== FREEZE =======================================================
+int8_t Dictionary::freeze() {
+    if (F) return DICTIONARY_OK;
+
+    FrozenIndex* f = new FrozenIndex;
+    int8_t rc = f->build(this);
+    if (rc) {
+        delete f;                 // nothing changed - still a normal dictionary
+        return (rc == NODEARRAY_MEM) ? DICTIONARY_MEM : DICTIONARY_ERR;
+    }
+    destroy();    // release the nodes, their buffers and the index
+#ifdef _DICT_ARENA
+    A->release(); // nothing is loaded into a frozen dictionary again
+#endif
+#ifdef _DICT_FLAT
+    delete L;     // ditto; destroy() makes a new one
+    L = NULL;
+#endif
+    F = f;
+    return DICTIONARY_OK;
+}
+
+int8_t Dictionary::freeze(const String& json) {
+    ReadBufferStream stream( (uint8_t*)json.c_str(), json.length() );
+    return freeze(stream);
+}
+
+// The pairs are loaded as nodes first (so duplicate keys behave exactly as with
+// jload) and packed straight away, so the nodes only exist during this call.
+int8_t Dictionary::freeze(Stream& json) {
+    int8_t rc = jload(json);
+    if (rc) return rc;
+    return freeze();
+}
+
+// ==== VALUE TIERS ==================================================
+#ifdef _DICT_TIERS
+// The hit counts are bucketed to find the lowest count t whose nodes, with all
+// the hotter ones, still fit the budget; the rest of the budget goes to nodes
+// with the next lower count, in positional order. Two passes make the same
+// choice: cold values move out first, so the internal RAM they free is there
+// for the promotions.
+static bool tierWanted(node* n, int t, size_t* room) {
+  if ( n->hits >= t ) return true;
+  if ( n->hits + 1 == t && n->hits > 0 && n->valBytes() <= *room ) {
+    *room -= n->valBytes();
+    return true;
+  }
+  return false;
+}
+
+int8_t Dictionary::rebalanceTiers(size_t budget) {
+  if (F) return DICTIONARY_ERR;
+
+  size_t* bytes = (size_t*) dictAlloc(sizeof(size_t) * 256, DICT_MEM_INDEX);  // value bytes per hit count
+  if (bytes == NULL) return DICTIONARY_MEM;
+  memset(bytes, 0, sizeof(size_t) * 256);
+
+  size_t n = Q->count();
+  for (size_t i = 0; i < n; i++) bytes[(*Q)[i]->hits] += (*Q)[i]->valBytes();
+
+  size_t used = 0;
+  int    t = 256;
+  while (t > 1 && used + bytes[t - 1] <= budget) used += bytes[--t];
+  dictFree(bytes, DICT_MEM_INDEX);
+
+  int8_t rc = DICTIONARY_OK;
+  size_t room = budget - used;
+  for (size_t i = 0; i < n; i++) {
+    node* p = (*Q)[i];
+    bool hot = tierWanted(p, t, &room);
+    if (!hot && p->vhot && p->moveValue(0) != NODEARRAY_OK) rc = DICTIONARY_MEM;
+  }
+  room = budget - used;
+  for (size_t i = 0; i < n; i++) {
+    node* p = (*Q)[i];
+    bool hot = tierWanted(p, t, &room);
+    if (hot && !p->vhot && p->moveValue(1) != NODEARRAY_OK) rc = DICTIONARY_MEM;
+    p->hits >>= 1;
+  }
+  return rc;
+}
+#endif
+
+
 // ==== OPERATORS ====================================
 
 bool Dictionary::operator () (const String& keystr) {
@@ -831,16 +3227,28 @@ bool Dictionary::operator () (const String& keystr) {
     iKeyTemp = (char*) keystr.c_str();
 #endif
 
-    uintNN_t key = crc(iKeyTemp, iKeyLen);
+    if (F) return F->find(iKeyTemp, iKeyLen) < F->count();
+#ifdef _DICT_BLOOM
+    if (!B->mayContain(iKeyTemp, iKeyLen)) return false;
+#endif
 
-    node* p = search(key, iRoot, iKeyTemp, iKeyLen);
+    uintNN_t key = crc(iKeyTemp, iKeyLen);
+#ifdef _DICT_FLAT
+    if (L) return L->find(key, iKeyTemp, iKeyLen) < L->count();
+#endif
+    node* p = search(key, iKeyTemp, iKeyLen);
     if (p) return true;
     return false;
 }
 
 
 bool Dictionary::operator == (Dictionary& b) {
-    if (b.size() != size()) return false;
+    // size() of a frozen or flat dictionary is its block size, so only compare like with like.
+#ifdef _DICT_FLAT
+    if ((F == NULL) == (b.F == NULL) && (L == NULL) == (b.L == NULL) && b.size() != size()) return false;
+#else
+    if ((F == NULL) == (b.F == NULL) && b.size() != size()) return false;
+#endif
     if (b.count() != count()) return false;
     size_t ct = count();
     for (size_t i = 0; i < ct; i++) {
@@ -853,21 +3261,106 @@ bool Dictionary::operator == (Dictionary& b) {
 
 
 // ==== PRIVATE METHODS ====================================================
+// memcmp() of two keys of the same length whose "crc" is already known to match.
+// A prefix "crc" holds the first 2/4/8 key bytes, so only the rest is compared, and
+// keys that short are equal without reading the node's key at all.
+static inline int nodeKeyRest(node* n, const char* keystr, _DICT_KEY_TYPE keylen) {
+#ifdef _DICT_HASH_PREFIX
+    if (keylen <= sizeof(uintNN_t)) return 0;
+    return memcmp(n->kbuf() + sizeof(uintNN_t), keystr + sizeof(uintNN_t), keylen - sizeof(uintNN_t));
+#else
+    return memcmp(n->kbuf(), keystr, keylen);
+#endif
+}
+
+#ifdef _DICT_ENGINE_TREE
+// ==== TREE ENGINE ========================================================
+#if defined(_DICT_SPLAY) || defined(_DICT_FLAT) || defined(_DICT_SINGLE_ALLOC)
+// Tree order of a key relative to node n (< 0: left of n), the same order the
+// plain walks in insert/search/deleteNode use: prefix, then length, then bytes.
+static inline int nodeTreeCompare(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, node* n) {
+    uintNN_t nk = n->key();
+    if (key != nk) return (key < nk) ? -1 : 1;
+    if (keylen != n->ksize) return (keylen < n->ksize) ? -1 : 1;
+    return nodeKeyRest(n, keystr, keylen);
+}
+#endif
+
 // ==== INSERTS ============================================================
-int8_t Dictionary::insert(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen, node* leaf) {
+int8_t Dictionary::insert(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen) {
+#ifdef _DICT_FLAT
+    if (L) return flatInsert(key, keystr, keylen, valstr, vallen);
+#endif
+#ifdef _DICT_SPLAY
+    // Splay the key's neighbourhood to the root; a new node then becomes the
+    // root and takes the old root's subtree on its side of the key.
+    iRoot = splay(iRoot, key, keystr, keylen);
+    if (iRoot != NULL) {
+        int cmpres = nodeTreeCompare(key, keystr, keylen, iRoot);
+        if (cmpres == 0) {  // same key - just update the value in place
+            return updateValue(iRoot, key, valstr, vallen);
+        }
+        int8_t rc;
+        node* n = newNode(key, keystr, keylen, valstr, vallen, &rc);
+        if (!n) return rc;
+        rc = Q->append(n);
+        if (rc) { freeNode(n); return rc; }
+        if (cmpres < 0) {
+            n->left = iRoot->left;
+            n->right = iRoot;
+            iRoot->left = NULL;
+        }
+        else {
+            n->right = iRoot->right;
+            n->left = iRoot;
+            iRoot->right = NULL;
+        }
+        iRoot = n;
+        return DICTIONARY_OK;
+    }
+#endif
+    if (iRoot == NULL) {
+        int8_t rc;
+
+        iRoot = newNode(key, keystr, keylen, valstr, vallen, &rc);
+
+#ifdef _LIBDEBUG_
+        Serial.printf("DICT-insert: creating root entry. rc = %d\n", rc);
+#endif
+
+        if (!iRoot) return rc;   // NULL: no dangling root for the next insert to read
+        rc = Q->append(iRoot);
+        if (rc) {
+            freeNode(iRoot);
+            iRoot = NULL;   // ditto: append failed, so the root is not tracked
+            return rc;
+        }
+        return DICTIONARY_OK;
+    }
+
+    node* leaf = iRoot;
+
     // Iterative descent (see search() for the stack-depth rationale). `goLeft`
     // records which child link a new node belongs under once we hit an empty
     // branch. We assign leaf->left / leaf->right directly (never take their
     // address) so this stays correct with _DICT_PACK_STRUCTURES, where those
     // members may be unaligned.
+#ifdef _DICT_BALANCED
+    // Remember the descent path so the new leaf's ancestors can be rebalanced.
+    node*  path[_DICT_MAX_HEIGHT];
+    size_t depth = 0;
+#endif
     for (;;) {
+#ifdef _DICT_BALANCED
+        path[depth++] = leaf;
+#endif
         uintNN_t lk = leaf->key();
         bool goLeft;
 
         if (key == lk) {
-            int cmpres = keylen != leaf->ksize ? keylen - leaf->ksize : memcmp(leaf->keybuf, keystr, keylen);
+            int cmpres = keylen != leaf->ksize ? keylen - leaf->ksize : nodeKeyRest(leaf, keystr, keylen);
             if (cmpres == 0) {  // same key - just update the value in place
-                return (leaf->updateValue(valstr, vallen) != NODEARRAY_OK) ? DICTIONARY_MEM : DICTIONARY_OK;
+                return updateValue(leaf, key, valstr, vallen);
             }
             goLeft = (cmpres < 0);
         }
@@ -883,26 +3376,33 @@ int8_t Dictionary::insert(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keyle
 
         // Empty branch: build the new child and only link it in after Q->append
         // succeeds, so a failure never leaves a dangling child pointer behind.
-        node* n = new node;
-        if (!n) return DICTIONARY_MEM;
-        int8_t rc = n->create(keystr, keylen, valstr, vallen, NULL, NULL);
-        if (rc) { delete n; return rc; }
+        int8_t rc;
+        node* n = newNode(key, keystr, keylen, valstr, vallen, &rc);
+        if (!n) return rc;
         rc = Q->append(n);
-        if (rc) { delete n; return rc; }
+        if (rc) { freeNode(n); return rc; }
         if (goLeft) leaf->left = n; else leaf->right = n;
+#ifdef _DICT_BALANCED
+        rebalance(path, depth);
+#endif
         return DICTIONARY_OK;
     }
 }
 
 
 // ==== SEARCH ===========================================================================
-node* Dictionary::search(uintNN_t key, node* leaf, const char* keystr, _DICT_KEY_TYPE keylen) {
+node* Dictionary::search(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen) {
+#ifdef _DICT_SPLAY
+    iRoot = splay(iRoot, key, keystr, keylen);
+    return (iRoot != NULL && nodeTreeCompare(key, keystr, keylen, iRoot) == 0) ? iRoot : NULL;
+#else
     // Iterative to avoid O(tree-depth) recursion, which can overflow the stack
     // on a degenerate/unbalanced tree (e.g. keys inserted in sorted order).
+    node* leaf = iRoot;
     while (leaf != NULL) {
         uintNN_t lk = leaf->key();
         if ( key == lk ) {
-            int cmpres = keylen != leaf->ksize ? keylen - leaf->ksize : memcmp(leaf->keybuf, keystr, keylen);
+            int cmpres = keylen != leaf->ksize ? keylen - leaf->ksize : nodeKeyRest(leaf, keystr, keylen);
             if (cmpres == 0) return leaf;
             leaf = ( cmpres < 0 ) ? leaf->left : leaf->right;
         }
@@ -911,29 +3411,60 @@ node* Dictionary::search(uintNN_t key, node* leaf, const char* keystr, _DICT_KEY
         }
     }
     return NULL;
+#endif
 }
 
 
 // ==== DELETES ==========================================================================
+int8_t Dictionary::deleteNode(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen) {
+#ifdef _DICT_FLAT
+    if (L) return flatDelete(key, keystr, keylen);
+#endif
+    iRoot = deleteNode(iRoot, key, keystr, keylen);
+    return DICTIONARY_OK;
+}
+
 // Iterative BST delete (no recursion - see search() for the stack-depth rationale).
-// Returns the new root of the (sub)tree. On an out-of-memory failure while promoting
-// the in-order successor, the tree is left unchanged and iError is set.
+// Returns the new root of the (sub)tree. Only links change, so it never allocates.
 node* Dictionary::deleteNode(node* root, uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen) {
+#ifdef _DICT_SPLAY
+  // Splay the key to the root, then join its subtrees: splaying the same key in
+  // the left subtree brings up its largest node, which has no right child yet.
+  // Nothing is copied, so this never allocates.
+  root = splay(root, key, keystr, keylen);
+  if (root == NULL || nodeTreeCompare(key, keystr, keylen, root) != 0) return root;
+  node* join = root->right;
+  if (root->left != NULL) {
+    join = splay(root->left, key, keystr, keylen);
+    join->right = root->right;
+  }
+  Q->remove(root);
+  freeNode(root);
+  return join;
+#else
   // Locate the target node and its parent.
   node* parent = NULL;
   node* cur    = root;
+#ifdef _DICT_BALANCED
+  // Ancestors of the node that is physically unlinked, for the rebalancing pass.
+  node*  path[_DICT_MAX_HEIGHT];
+  size_t depth = 0;
+#endif
 
   while (cur != NULL) {
     uintNN_t ck = cur->key();
     int cmpres;
     if (key == ck) {
-      cmpres = (keylen != cur->ksize) ? (int)keylen - (int)cur->ksize : memcmp(cur->keybuf, keystr, keylen);
+      cmpres = (keylen != cur->ksize) ? (int)keylen - (int)cur->ksize : nodeKeyRest(cur, keystr, keylen);
       if (cmpres == 0) break;   // found it
     }
     else {
       cmpres = (key < ck) ? -1 : 1;
     }
     parent = cur;
+#ifdef _DICT_BALANCED
+    path[depth++] = cur;
+#endif
     cur = (cmpres < 0) ? cur->left : cur->right;
   }
 
@@ -944,45 +3475,502 @@ node* Dictionary::deleteNode(node* root, uintNN_t key, const char* keystr, _DICT
   if (cur->left != NULL && cur->right != NULL) {
     node* succParent = cur;
     node* succ       = cur->right;
-    while (succ->left != NULL) { succParent = succ; succ = succ->left; }
-
-    // Copy the successor's key/value into cur atomically. If it fails (OOM),
-    // leave the whole tree intact and surface the error via iError.
-    if (cur->updateKeyValue(succ->keybuf, succ->ksize, succ->valbuf, succ->vsize) != NODEARRAY_OK) {
-      iError = DICTIONARY_MEM;
-      return root;
+#ifdef _DICT_BALANCED
+    path[depth++] = cur;
+#endif
+    while (succ->left != NULL) {
+      succParent = succ;
+#ifdef _DICT_BALANCED
+      path[depth++] = succ;
+#endif
+      succ = succ->left;
     }
 
-    node* succChild = succ->right;
-    if (succParent->left == succ) succParent->left = succChild;
-    else                          succParent->right = succChild;
-    Q->remove(succ);
-    delete succ;
+    // The successor node itself takes cur's place in the tree. Copying its key
+    // and value into cur instead could need bigger buffers (and fail on OOM), and
+    // would leave behind what the node carries besides its bytes: its tier and
+    // hit count, its place in the insertion order. Nothing is allocated.
+    if (succParent != cur) {
+      succParent->left = succ->right;
+      succ->right = cur->right;
+    }
+    succ->left = cur->left;
+#ifdef _DICT_BALANCED
+    succ->height = cur->height;
+    for (size_t i = 0; i < depth; i++) {
+      if (path[i] == cur) path[i] = succ;
+    }
+#endif
+    if (parent == NULL)            root = succ;
+    else if (parent->left == cur)  parent->left = succ;
+    else                           parent->right = succ;
+    Q->remove(cur);
+    freeNode(cur);
+#ifdef _DICT_BALANCED
+    if (parent == NULL) iRoot = succ;
+    rebalance(path, depth);
+    return iRoot;
+#else
     return root;
+#endif
   }
 
   // Node with zero or one child: splice it out.
   node* child = (cur->left != NULL) ? cur->left : cur->right;   // may be NULL
   if (parent == NULL) {           // deleting the root of this (sub)tree
     Q->remove(cur);
-    delete cur;
+    freeNode(cur);
     return child;                 // child becomes the new root
   }
   if (parent->left == cur) parent->left = child;
   else                     parent->right = child;
   Q->remove(cur);
-  delete cur;
+  freeNode(cur);
+#ifdef _DICT_BALANCED
+  rebalance(path, depth);
+  return iRoot;
+#else
   return root;
+#endif
+#endif // _DICT_SPLAY
+}
+
+
+#ifdef _DICT_BALANCED
+// ==== AVL BALANCING ====================================================================
+// Rotations assign left/right directly (never through a reference) so they stay
+// valid with _DICT_PACK_STRUCTURES. Both return the new root of the subtree.
+void Dictionary::updateHeight(node* n) {
+  uint8_t hl = n->left  ? n->left->height  : 0;
+  uint8_t hr = n->right ? n->right->height : 0;
+  n->height = (hl > hr ? hl : hr) + 1;
+}
+
+node* Dictionary::rotateLeft(node* n) {
+  node* r = n->right;
+  n->right = r->left;
+  r->left = n;
+  updateHeight(n);
+  updateHeight(r);
+  return r;
+}
+
+node* Dictionary::rotateRight(node* n) {
+  node* l = n->left;
+  n->left = l->right;
+  l->right = n;
+  updateHeight(n);
+  updateHeight(l);
+  return l;
+}
+
+// Walk the recorded root-to-leaf path bottom-up, restoring the AVL invariant.
+// path[0] is always iRoot; a rotated subtree is re-attached to path[i-1] (or
+// becomes the new iRoot). Once a subtree ends up with the same height it had
+// before the change, nothing above it can be affected, so the walk stops early.
+void Dictionary::rebalance(node** path, size_t depth) {
+  while (depth > 0) {
+    node* n = path[--depth];
+    uint8_t oldHeight = n->height;
+    updateHeight(n);
+
+    int hl = n->left  ? n->left->height  : 0;
+    int hr = n->right ? n->right->height : 0;
+    node* r = n;
+
+    if (hl - hr > 1) {
+      node* l = n->left;
+      if ((l->left ? l->left->height : 0) < (l->right ? l->right->height : 0))
+        n->left = rotateLeft(l);
+      r = rotateRight(n);
+    }
+    else if (hr - hl > 1) {
+      node* rt = n->right;
+      if ((rt->right ? rt->right->height : 0) < (rt->left ? rt->left->height : 0))
+        n->right = rotateRight(rt);
+      r = rotateLeft(n);
+    }
+
+    if (r != n) {
+      node* up = depth ? path[depth - 1] : NULL;
+      if (up == NULL)          iRoot = r;
+      else if (up->left == n)  up->left = r;
+      else                     up->right = r;
+    }
+    if (r->height == oldHeight) break;
+  }
+}
+#endif // _DICT_BALANCED
+
+
+#ifdef _DICT_SPLAY
+// ==== SPLAYING =========================================================================
+// Top-down splay (Sleator & Tarjan, "Self-Adjusting Binary Search Trees", 1985).
+// The walk down from t peels off the nodes below the key into a left tree and the
+// ones above it into a right tree, rotating at every second step so that the path
+// is roughly halved; the last node reached becomes the root with the two trees as
+// its children. Returns the new root: the key's node if present, else the last
+// node on its search path. Links are assigned directly, as in the AVL rotations.
+node* Dictionary::splay(node* t, uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen) {
+  if (t == NULL) return NULL;
+
+  node  header;             // header.right: left tree, header.left: right tree
+  node* l = &header;        // largest node of the left tree
+  node* r = &header;        // smallest node of the right tree
+  header.left = NULL;
+  header.right = NULL;
+
+  // Each node on the path is compared once: without a rotation the result for
+  // the child is the result for the next t.
+  int cmpres = nodeTreeCompare(key, keystr, keylen, t);
+  while (cmpres != 0) {
+    bool rotated = false;
+    if (cmpres < 0) {
+      if (t->left == NULL) break;
+      cmpres = nodeTreeCompare(key, keystr, keylen, t->left);
+      if (cmpres < 0) {     // zig-zig: rotate right
+        node* y = t->left;
+        t->left = y->right;
+        y->right = t;
+        t = y;
+        if (t->left == NULL) break;
+        rotated = true;
+      }
+      r->left = t;          // t and its right subtree are above the key
+      r = t;
+      t = t->left;
+    }
+    else {
+      if (t->right == NULL) break;
+      cmpres = nodeTreeCompare(key, keystr, keylen, t->right);
+      if (cmpres > 0) {     // zag-zag: rotate left
+        node* y = t->right;
+        t->right = y->left;
+        y->left = t;
+        t = y;
+        if (t->right == NULL) break;
+        rotated = true;
+      }
+      l->right = t;         // t and its left subtree are below the key
+      l = t;
+      t = t->right;
+    }
+    if (rotated) cmpres = nodeTreeCompare(key, keystr, keylen, t);
+  }
+
+  l->right = t->left;
+  r->left = t->right;
+  t->left = header.right;
+  t->right = header.left;
+  return t;
+}
+#endif // _DICT_SPLAY
+#endif // _DICT_ENGINE_TREE
+
+
+#ifdef _DICT_INDEX_EXTERNAL
+// ==== EXTERNAL INDEX ENGINES (_DICT_ENGINE_HASH / _SWISS / _ART / _BTREE) ==========
+int8_t Dictionary::insert(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen) {
+#ifdef _DICT_FLAT
+    if (L) return flatInsert(key, keystr, keylen, valstr, vallen);
+#endif
+    node* p = H->find(key, keystr, keylen);
+    if (p) {  // same key - just update the value in place
+        return updateValue(p, key, valstr, vallen);
+    }
+
+    int8_t rc;
+    node* n = newNode(key, keystr, keylen, valstr, vallen, &rc);
+    if (!n) return rc;
+    rc = Q->append(n);
+    if (rc) { freeNode(n); return rc; }
+    rc = H->insert(n, key);
+    if (rc) { Q->remove(n); freeNode(n); return rc; }
+    return DICTIONARY_OK;
+}
+
+node* Dictionary::search(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen) {
+    return H->find(key, keystr, keylen);
+}
+
+int8_t Dictionary::deleteNode(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen) {
+#ifdef _DICT_FLAT
+    if (L) return flatDelete(key, keystr, keylen);
+#endif
+    node* p = H->remove(key, keystr, keylen);
+    if (p) {
+        Q->remove(p);
+        freeNode(p);
+    }
+    return DICTIONARY_OK;
+}
+#endif // _DICT_INDEX_EXTERNAL
+
+
+#ifdef _DICT_FLAT
+// ==== FLAT (SMALL DICTIONARY) MODE =====================================================
+// While L is set, it holds every pair and there are no nodes: Q and the index are
+// empty. promote() moves the pairs into nodes, in the same positional order.
+int8_t Dictionary::flatInsert(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen) {
+    size_t ct = L->count();
+    size_t i = L->find(key, keystr, keylen);
+    if (i == ct && ct == _DICT_FLAT_MAX) {
+        // Outgrown: index the existing entries, then insert through the engine.
+        int8_t rc = promote();
+        if (rc) return rc;
+        return insert(key, keystr, keylen, valstr, vallen);
+    }
+    return L->put(i, key, keystr, keylen, valstr, vallen) == NODEARRAY_OK ? DICTIONARY_OK : DICTIONARY_MEM;
+}
+
+int8_t Dictionary::flatDelete(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen) {
+    size_t i = L->find(key, keystr, keylen);
+    if (i < L->count()) L->remove(i);
+    return DICTIONARY_OK;
+}
+
+#ifdef _DICT_ENGINE_TREE
+// Balanced tree over n nodes sorted in tree order; returns its root. The depth
+// of the recursion is log2(_DICT_FLAT_MAX + 1) at most.
+static node* nodeTreeBuild(node** sorted, size_t n) {
+    if (n == 0) return NULL;
+    size_t m = n / 2;
+    node*  r = sorted[m];
+    r->left = nodeTreeBuild(sorted, m);
+    r->right = nodeTreeBuild(sorted + m + 1, n - m - 1);
+#ifdef _DICT_BALANCED
+    uint8_t hl = r->left  ? r->left->height  : 0;
+    uint8_t hr = r->right ? r->right->height : 0;
+    r->height = (hl > hr ? hl : hr) + 1;
+#endif
+    return r;
+}
+#endif
+
+// Make a node of every pair, append it to Q and index it, then free the block.
+// The tree is built balanced from the sorted nodes. If a node, Q or an external
+// index runs out of memory, the nodes made so far are freed again and the
+// dictionary stays flat.
+int8_t Dictionary::promote() {
+    size_t ct = L->count();
+    size_t i;
+
+    for (i = 0; i < ct; i++) {
+        const char*     k  = NULL;
+        _DICT_KEY_TYPE  kl = 0;
+        const char*     v  = NULL;
+        _DICT_VAL_TYPE  vl = 0;
+        int8_t          rc;
+        L->entry(i, &k, &kl, &v, &vl);
+        node* n = newNode(L->key(i), k, kl, v, vl, &rc);
+        if (!n) break;
+        if (Q->append(n)) { freeNode(n); break; }
+#ifdef _DICT_INDEX_EXTERNAL
+        if (H->insert(n, L->key(i))) { Q->remove(n); freeNode(n); break; }
+#endif
+    }
+    if (i < ct) {
+        while (i--) {             // node i is the last one of Q
+            node* n = (*Q)[i];
+#ifdef _DICT_INDEX_EXTERNAL
+            H->remove(L->key(i), n->kbuf(), n->ksize);   // never allocates
+#endif
+            Q->remove(n);
+            freeNode(n);
+        }
+        return DICTIONARY_MEM;
+    }
+
+#ifdef _DICT_ENGINE_TREE
+    node* sorted[_DICT_FLAT_MAX];
+    for (i = 0; i < ct; i++) {            // insertion sort: at most _DICT_FLAT_MAX nodes
+        node*  n = (*Q)[i];
+        size_t j = i;
+        while (j > 0 && nodeTreeCompare(n->key(), n->kbuf(), n->ksize, sorted[j - 1]) < 0) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = n;
+    }
+    iRoot = nodeTreeBuild(sorted, ct);
+#endif
+    delete L;
+    L = NULL;
+    return DICTIONARY_OK;
+}
+#endif // _DICT_FLAT
+
+
+// ==== NODES =============================================================================
+node* Dictionary::newNode(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen, int8_t* rc) {
+#if defined(_DICT_ARENA_OFFSETS)
+    _DICT_REF_TYPE ref;
+    node* n = (node*) A->alloc(node::blockSize(keylen, vallen), &ref);
+#elif defined(_DICT_ARENA)
+    node* n = (node*) A->alloc(node::blockSize(keylen, vallen));
+#elif defined(_DICT_SLAB)
+    node* n = S->allocNode();
+#else
+    node* n = new (keylen, vallen) node;
+#endif
+    if (!n) {
+        *rc = DICTIONARY_MEM;
+        return NULL;
+    }
+#if defined(_DICT_ARENA_OFFSETS) && defined(_DICT_ENGINE_TREE)
+    n->self = ref;
+#elif defined(_DICT_ARENA_OFFSETS)
+    (void) ref;
+#endif
+#ifdef _DICT_SLAB
+    *rc = n->create(keystr, keylen, valstr, vallen, key, S);
+#else
+    *rc = n->create(keystr, keylen, valstr, vallen, key);
+#endif
+    if (*rc) {
+        freeNode(n);    // create() leaves no buffer behind on failure
+        return NULL;
+    }
+    return n;
+}
+
+void Dictionary::freeNode(node* n) {
+#ifdef _DICT_SLAB
+    size_t ks = n->ksize < sizeof(uintNN_t) ? sizeof(uintNN_t) : n->ksize;
+    S->release(n->keybuf, ks + _DICT_EXTRA, DICT_MEM_KEY);
+    S->release(n->valbuf, n->vsize + _DICT_EXTRA, DICT_MEM_VALUE);
+    S->releaseNode(n);
+#else
+    delete n;
+#endif
+}
+
+
+// ==== VALUE UPDATES =====================================================================
+int8_t Dictionary::updateValue(node* n, uintNN_t key, const char* valstr, _DICT_VAL_TYPE vallen) {
+#ifdef _DICT_SINGLE_ALLOC
+    // A value that does not fit in the node's block moves the node: the copy takes
+    // its place in Q and in the index before the old block is freed.
+    if (vallen > n->vcap) {
+        node* m = n->resized(valstr, vallen);
+        if (!m) return DICTIONARY_MEM;
+        relink(n, m, key);
+        freeNode(n);
+        return DICTIONARY_OK;
+    }
+#else
+    (void) key;
+#endif
+#if defined(_DICT_SLAB)
+    if (n->updateValue(valstr, vallen, S) != NODEARRAY_OK) return DICTIONARY_MEM;
+#elif defined(_DICT_ARENA)
+    if (n->updateValue(valstr, vallen, A) != NODEARRAY_OK) return DICTIONARY_MEM;
+#else
+    if (n->updateValue(valstr, vallen) != NODEARRAY_OK) return DICTIONARY_MEM;
+#endif
+    return DICTIONARY_OK;
+}
+
+
+#ifdef _DICT_SINGLE_ALLOC
+void Dictionary::relink(node* n, node* m, uintNN_t key) {
+    Q->replace(n, m);
+#ifdef _DICT_ENGINE_TREE
+    if (iRoot == n) {
+        iRoot = m;
+        return;
+    }
+    // Walk down to n's parent; m has the same key, so it leads the same way.
+    node* p = iRoot;
+    while (p != NULL) {
+        bool goLeft = nodeTreeCompare(key, m->kbuf(), m->ksize, p) < 0;
+        node* child = goLeft ? p->left : p->right;
+        if (child == n) {
+            if (goLeft) p->left = m; else p->right = m;
+            return;
+        }
+        p = child;
+    }
+#else
+    H->relink(m, key);
+#endif
 }
+#endif // _DICT_SINGLE_ALLOC
 
 
 // ==== KEY/CRC METHODS ===============================================
 
+// The key "crc" is whatever the hashing policy (_DICT_HASH_*) says it is. The
+// tree only needs a cheap total order with few ties; a hash table needs every
+// key byte to contribute.
 uintNN_t Dictionary::crc(const void* data, size_t n_bytes) {
+    const uint8_t* b = (const uint8_t*) data;
+
+#if defined(_DICT_HASH_FNV1A)
+#if _DICT_CRC == 64
+    uint64_t    h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < n_bytes; i++) {
+        h ^= b[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+#else
+    uint32_t    h = 2166136261UL;
+
+    for (size_t i = 0; i < n_bytes; i++) {
+        h ^= b[i];
+        h *= 16777619UL;
+    }
+#if _DICT_CRC == 16
+    return (uint16_t)(h ^ (h >> 16));
+#else
+    return h;
+#endif
+#endif
+
+#elif defined(_DICT_HASH_CRC32C)
+    uint32_t    c = 0xFFFFFFFFUL;
+
+#ifdef _DICT_HAVE_SSE42
+#if defined(__x86_64__)
+    for (; n_bytes >= 8; n_bytes -= 8, b += 8) {
+        uint64_t w;
+        memcpy(&w, b, 8);
+        c = (uint32_t) _mm_crc32_u64(c, w);
+    }
+#endif
+    for (; n_bytes >= 4; n_bytes -= 4, b += 4) {
+        uint32_t w;
+        memcpy(&w, b, 4);
+        c = _mm_crc32_u32(c, w);
+    }
+    for (; n_bytes; n_bytes--) c = _mm_crc32_u8(c, *b++);
+#else
+    // Half-byte table: 64 bytes of flash instead of the usual 1 KB.
+    static const uint32_t T[16] = {
+        0x00000000UL, 0x105EC76FUL, 0x20BD8EDEUL, 0x30E349B1UL, 0x417B1DBCUL, 0x5125DAD3UL, 0x61C69362UL, 0x7198540DUL,
+        0x82F63B78UL, 0x92A8FC17UL, 0xA24BB5A6UL, 0xB21572C9UL, 0xC38D26C4UL, 0xD3D3E1ABUL, 0xE330A81AUL, 0xF36E6F75UL
+    };
+    for (; n_bytes; n_bytes--) {
+        c ^= *b++;
+        c = (c >> 4) ^ T[c & 0x0F];
+        c = (c >> 4) ^ T[c & 0x0F];
+    }
+#endif
+    c ^= 0xFFFFFFFFUL;
+#if _DICT_CRC == 16
+    return (uint16_t)(c ^ (c >> 16));
+#else
+    return c;
+#endif
+
+#else   // _DICT_HASH_PREFIX
     uintNN_t    a = 0;
 
-    memcpy((void*)&a, data, n_bytes < sizeof(uintNN_t) ? n_bytes : sizeof(uintNN_t));
+    memcpy((void*)&a, b, n_bytes < sizeof(uintNN_t) ? n_bytes : sizeof(uintNN_t));
     return a;
+#endif
 }
 
 
@@ -1054,7 +4042,7 @@ void Dictionary::decompressValue(const char* aBuf, _DICT_VAL_TYPE aLen) {
 
 
 // ==== DEBUG METHODS ===================================================
-#ifdef _LIBDEBUG_
+#if defined(_LIBDEBUG_) && defined(_DICT_ENGINE_TREE)
 void Dictionary::printDictionary(node* root) {
   if (root != NULL)
   {
@@ -1066,8 +4054,8 @@ void Dictionary::printDictionary(node* root) {
 
 void Dictionary::printNode(node* root) {
   if (root != NULL) {
-//    Serial.printf("%u: (%u:%s,%s %u:%u) [l:%u, r:%u]\n", (uint32_t)root, root->key(), root->keybuf, root->valbuf, (uint32_t)root->keybuf, (uint32_t)root->valbuf, (uint32_t)root->left, (uint32_t)root->right);
-    Serial.printf("%u: (%u:%u:%u) [l:%u, r:%u]\n", (uint32_t)root, root->key(), (uint32_t)root->keybuf, (uint32_t)root->valbuf, (uint32_t)root->left, (uint32_t)root->right);
+//    Serial.printf("%u: (%u:%s,%s %u:%u) [l:%u, r:%u]\n", (uint32_t)root, root->key(), root->kbuf(), root->vbuf(), (uint32_t)root->kbuf(), (uint32_t)root->vbuf(), (uint32_t)root->left, (uint32_t)root->right);
+    Serial.printf("%u: (%u:%u:%u) [l:%u, r:%u]\n", (uint32_t)root, root->key(), (uint32_t)root->kbuf(), (uint32_t)root->vbuf(), (uint32_t)root->left, (uint32_t)root->right);
   }
   else {
     Serial.println("NULL:");
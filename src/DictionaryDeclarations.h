@@ -124,6 +124,85 @@
                - update: read operations no longer mutate node buffers (non-compressed
                  builds); jsize()/esize() read node sizes directly.
 
+  v3.7.0:
+    2026-10-16 - feature: self-balancing (AVL) tree mode via #define _DICT_BALANCED.
+                 Insert/search/delete stay O(log n) even for sorted-order keys.
+               - feature: compile-time index engine selection. #define _DICT_ENGINE_HASH
+                 replaces the tree with an open-addressing (Robin Hood) hash table with
+                 incremental growth; nodes then carry no child pointers.
+               - feature: pluggable key hashing. #define _DICT_HASH_FNV1A or _DICT_HASH_CRC32C
+                 (SSE4.2 accelerated on hosts that have it) to order/index keys by a hash
+                 of the whole key instead of its first 2/4/8 bytes (_DICT_HASH_PREFIX, the
+                 default for the tree engine).
+               - feature: #define _DICT_ENGINE_SWISS selects a Swiss-table style engine:
+                 1-byte hash tags in groups of 16 probed with one SSE2 compare (scalar
+                 fallback elsewhere), one pointer + one tag byte per slot.
+               - feature: freeze() turns a loaded dictionary into a read-only flat block:
+                 keys and values packed together, key hashes in Eytzinger order for a
+                 branch-free, prefetching binary search. Frees all per-entry allocations.
+               - feature: #define _DICT_FREEZE_MPH indexes frozen dictionaries with a minimal
+                 perfect hash (CHD) instead: one probe and one key compare per lookup.
+                 freeze(json) loads and freezes in one call.
+               - feature: StaticDictionary.h - constexpr dictionary of key/value literals,
+                 hashed at compile time into a read-only table (C++14).
+               - feature: #define _DICT_ENGINE_ART selects an adaptive radix tree engine
+                 (O(key length) lookups, shared key prefixes stored once in the index).
+               - feature: forEachPrefix(prefix, callback) visits every pair whose key starts
+                 with prefix (a subtree walk on the ART engine, a scan otherwise).
+               - feature: #define _DICT_ENGINE_BTREE selects a B-tree engine: up to
+                 _DICT_BTREE_ORDER (16) children per node, key prefixes stored inline
+                 and scanned together, so a lookup reads ~log16(n) nodes, not log2(n).
+               - feature: splay tree mode via #define _DICT_SPLAY. Every access moves its
+                 key to the root, so a few hot keys are found in one or two steps.
+               - feature: #define _DICT_FLAT stores dictionaries of up to _DICT_FLAT_MAX (8)
+                 entries packed in one block, with no nodes and no index: lookups scan
+                 the key prefixes and lengths at its start. The first insert past the
+                 limit moves the entries into indexed nodes and frees the block.
+               - feature: #define _DICT_BLOOM puts a counting Bloom filter in front of
+                 search() and d("key"): most lookups of absent keys return without
+                 touching a node. remove() takes keys back out of the filter.
+               - feature: #define _DICT_SINGLE_ALLOC stores every node, its key and its
+                 value in one heap block instead of three. A value that outgrows
+                 the block moves the node to a bigger one.
+               - feature: #define _DICT_SSO keeps keys and values of up to _DICT_SSO_LEN
+                 (7) bytes inside the node, in place of their buffer pointers.
+               - feature: #define _DICT_ARENA carves nodes, keys and values out of a few
+                 large chunks owned by the dictionary. destroy() rewinds the chunks
+                 for the next load instead of freeing every entry.
+               - feature: #define _DICT_SLAB recycles removed nodes and key/value buffers
+                 through per-dictionary free lists, one per size class, so insert /
+                 update / remove churn does not fragment the heap.
+               - feature: allocation policy. Every block is tagged with a region (nodes,
+                 keys, values, index); _DICT_PSRAM_REGIONS picks the regions that go
+                 to ESP32 PSRAM, and Dictionary::setAllocator() installs a custom
+                 policy. The copies of the ps_malloc/malloc fallback are gone.
+               - feature: #define _DICT_TIERS samples search() hits per entry;
+                 rebalanceTiers(budget) keeps the values of the hottest entries in
+                 internal RAM (DICT_MEM_HOT) and the rest in DICT_MEM_VALUE.
+               - tree engine: equal-length keys of up to 2/4/8 bytes (CRC16/32/64) are
+                 told apart by their prefix "crc" alone, without reading the key.
+               - tree engine: nodes keep the key prefix "crc" too (not only a full-key
+                 hash) and lead with it, the key length and the child links, so a
+                 lookup reads one cache line per level instead of two.
+               - feature: #define _DICT_ARENA_OFFSETS 16 or 32 (with _DICT_ARENA) stores
+                 child links and moved values as handles into the arena's chunks and
+                 finds the key after the node: a 20-byte tree node on ESP32 with
+                 16-bit handles (28 with pointers).
+                 The chunk table is shared by all dictionaries and is not locked.
+               - update: node fields reordered so the unpacked layout has no inner
+                 padding: 24 bytes on ESP32 (was 28), as much heap as packed.
+               - update: the positional array (key(i)/value(i)) grows in fixed-size
+                 segments instead of doubling and copying, and gives them back on removes.
+               - update: remove() takes a node out of the positional array in O(1): each
+                 node keeps its position and the last pair moves into the freed one.
+                 #define _DICT_MAX_PAIRS (default UINT32_MAX) sizes that field.
+               - feature: #define _DICT_ORDERED keeps insertion order across removes with
+                 a list through the nodes in place of the positional array.
+               - feature: DictionaryIterator: for (auto& e : d) walks the pairs by position.
+               - update: remove() never allocates: a tree node with two children is
+                 replaced by relinking its successor node, never by copying the
+                 successor's key and value into it (node::updateKeyValue is gone).
+
  */
 
 
@@ -223,6 +302,271 @@
 #define uintNN_t uint64_t
 #endif
 
+
+// Index engine: how keys are mapped to nodes. The default is the binary tree.
+// The public API is identical for every engine.
+//
+// #define _DICT_ENGINE_HASH    // Robin Hood open-addressing hash table (O(1)
+//                              // expected lookups, no left/right pointers in nodes)
+// #define _DICT_ENGINE_SWISS   // SIMD group-probing hash table: 1-byte tags in
+//                              // groups of 16, matched with one SSE2 compare
+// #define _DICT_ENGINE_ART     // adaptive radix tree over the key bytes: O(key length)
+//                              // lookups and ordered prefix walks (forEachPrefix)
+// #define _DICT_ENGINE_BTREE   // B-tree: many keys per node, their uintNN_t prefixes
+//                              // side by side, so each level is one short scan
+#if (defined(_DICT_ENGINE_HASH) + defined(_DICT_ENGINE_SWISS) + defined(_DICT_ENGINE_ART) + defined(_DICT_ENGINE_BTREE)) > 1
+#error "select only one _DICT_ENGINE_*"
+#endif
+
+#if defined(_DICT_ENGINE_HASH) || defined(_DICT_ENGINE_SWISS)
+#define _DICT_ENGINE
+#define _DICT_INDEX_TABLE       // nodes are indexed by a hash table
+#endif
+
+#if defined(_DICT_ENGINE_ART) || defined(_DICT_ENGINE_BTREE)
+#define _DICT_ENGINE
+#endif
+
+// B-tree order: the maximum number of children of a node (which then holds up to
+// _DICT_BTREE_ORDER - 1 keys). 16 puts the 32-bit prefixes of a node in one 64-byte
+// cache line.
+#ifdef _DICT_ENGINE_BTREE
+#ifndef _DICT_BTREE_ORDER
+#define _DICT_BTREE_ORDER   16
+#endif
+#if _DICT_BTREE_ORDER < 4 || _DICT_BTREE_ORDER > 64 || (_DICT_BTREE_ORDER % 2)
+#error "_DICT_BTREE_ORDER must be an even number from 4 to 64"
+#endif
+#endif
+
+#ifdef _DICT_ENGINE
+#define _DICT_INDEX_EXTERNAL    // nodes carry no links; a separate index H finds them
+#endif
+
+#ifndef _DICT_ENGINE
+#define _DICT_ENGINE_TREE
+#endif
+
+// #define _DICT_NO_SIMD forces the portable code paths even where SSE2/SSE4.2 exist.
+#if defined(__SSE2__) && !defined(_DICT_NO_SIMD)
+#include <emmintrin.h>
+#define _DICT_HAVE_SSE2
+#endif
+
+
+// Key hashing policy - how crc() turns a key into its uintNN_t:
+//
+// #define _DICT_HASH_PREFIX    // first 2/4/8 key bytes, zero padded (tree default).
+//                              // Cheapest, but keys sharing a long prefix all map
+//                              // to the same value and fall back to memcmp.
+// #define _DICT_HASH_FNV1A     // FNV-1a over the whole key (hash engine default).
+// #define _DICT_HASH_CRC32C    // CRC-32C over the whole key; uses the SSE4.2 crc32
+//                              // instruction when compiled for it (-msse4.2).
+//
+// The tree nodes keep the key's value (sizeof(uintNN_t) bytes) next to their links,
+// so a walk does not read the key bytes at every level.
+#if defined(_DICT_INDEX_TABLE) && !defined(_DICT_HASH_FNV1A) && !defined(_DICT_HASH_CRC32C)
+#ifdef _DICT_HASH_PREFIX
+#error "hash table engines need a full-key hash (_DICT_HASH_FNV1A or _DICT_HASH_CRC32C)"
+#endif
+#define _DICT_HASH_FNV1A
+#endif
+
+#if defined(_DICT_HASH_FNV1A) || defined(_DICT_HASH_CRC32C)
+#define _DICT_HASH_KEYS
+#else
+#define _DICT_HASH_PREFIX
+#endif
+
+#if defined(_DICT_HASH_CRC32C) && defined(__SSE4_2__) && !defined(_DICT_NO_SIMD)
+#include <nmmintrin.h>
+#define _DICT_HAVE_SSE42
+#endif
+
+#if defined(_DICT_BALANCED) && !defined(_DICT_ENGINE_TREE)
+#error "_DICT_BALANCED only applies to the tree engine"
+#endif
+
+// Self-balancing tree: #define _DICT_BALANCED keeps the node tree AVL-balanced
+// (1 extra byte per node for the subtree height), so lookups are O(log n) in the
+// worst case. An AVL tree of height h holds at least Fib(h+2)-1 nodes, so 48
+// levels of rebalancing path is enough for any dictionary that fits in memory.
+#ifdef _DICT_BALANCED
+#define _DICT_MAX_HEIGHT  48
+#endif
+
+// Splay tree: #define _DICT_SPLAY moves every key that is searched, inserted or
+// removed to the root with top-down splaying (Sleator & Tarjan). Frequently read
+// keys stay near the root; any sequence of m operations costs O(m log n) in total.
+// No extra memory per node, but search() restructures the tree.
+#if defined(_DICT_SPLAY) && !defined(_DICT_ENGINE_TREE)
+#error "_DICT_SPLAY only applies to the tree engine"
+#endif
+
+#if defined(_DICT_SPLAY) && defined(_DICT_BALANCED)
+#error "select either _DICT_SPLAY or _DICT_BALANCED"
+#endif
+
+// Small-dictionary mode: #define _DICT_FLAT stores a dictionary of at most
+// _DICT_FLAT_MAX entries packed in one block (see NodeFlat), with no nodes and no
+// index. The first insert of a new key past the limit moves the entries into
+// nodes indexed by the selected engine (a tree is built balanced) and frees the
+// block; the dictionary stays indexed until destroy().
+#ifdef _DICT_FLAT
+#ifndef _DICT_FLAT_MAX
+#define _DICT_FLAT_MAX  8
+#endif
+#if _DICT_FLAT_MAX < 1 || _DICT_FLAT_MAX > 64
+#error "_DICT_FLAT_MAX must be from 1 to 64"
+#endif
+#endif
+
+// Fast misses: #define _DICT_BLOOM keeps a counting Bloom filter of the keys
+// (_DICT_BLOOM_BITS 4-bit counters per key, 4 bytes per key by default) that
+// search() and d("key") check first; a key it rules out is not looked up at all.
+// The filter doubles, rebuilt from the nodes, as the dictionary grows.
+#ifdef _DICT_BLOOM
+#ifndef _DICT_BLOOM_BITS
+#define _DICT_BLOOM_BITS  8
+#endif
+#endif
+
+// Single-allocation nodes: #define _DICT_SINGLE_ALLOC allocates each node with its
+// key and value bytes trailing it, one malloc instead of three. The block is rounded
+// up to _DICT_NODE_ALIGN bytes and the spare bytes are value capacity; a value that
+// does not fit moves the node into a new block, which then replaces it in the
+// positional array and in the index.
+#ifdef _DICT_SINGLE_ALLOC
+#define _DICT_NODE_BLOCK
+#endif
+
+// Small-string optimization: #define _DICT_SSO stores a key or value of up to
+// _DICT_SSO_LEN bytes inside the node, in the bytes of its buffer pointer (widened
+// to fit if needed), so short strings need no heap block of their own. Whether a
+// string is inline follows from its length alone.
+#ifdef _DICT_SSO
+#ifndef _DICT_SSO_LEN
+#define _DICT_SSO_LEN  7
+#endif
+#if _DICT_SSO_LEN < 1 || _DICT_SSO_LEN > 64
+#error "_DICT_SSO_LEN must be from 1 to 64"
+#endif
+#endif
+
+// Arena allocation: #define _DICT_ARENA takes every node, with its key and value
+// bytes trailing it, from chunks of _DICT_ARENA_CHUNK bytes owned by the dictionary
+// (one bump of a pointer per insert). Nothing is freed piecemeal: destroy() rewinds
+// the chunks and the next load reuses them, so reloading a configuration does not
+// fragment the heap. A value that outgrows its slot moves to new arena bytes. Bytes
+// of removed entries, and those a value moved away from, come back only with destroy().
+#ifdef _DICT_ARENA
+#ifndef _DICT_ARENA_CHUNK
+#define _DICT_ARENA_CHUNK  1024
+#endif
+#define _DICT_NODE_BLOCK
+#endif
+
+// Arena handles: with _DICT_ARENA, #define _DICT_ARENA_OFFSETS 16 (or 32) keeps a
+// node's child links and the location of a moved value as 16- or 32-bit handles
+// into the arena's chunks instead of pointers, and finds the key right after the
+// node: a tree node takes 20 bytes instead of 28 on ESP32 with 16-bit handles, 28
+// instead of 48 on a 64-bit host with 32-bit ones, and its links do not depend on
+// where the chunks are. A handle is a chunk number, in a table shared by every
+// arena, and an offset into the chunk in 8-byte units: each chunk is exactly
+// _DICT_ARENA_CHUNK bytes (a power of two, big enough for the largest entry), and
+// 16-bit handles reach 512 KB of chunks in all.
+// The table is global: once it is full, an insert that needs a new chunk fails with
+// DICTIONARY_MEM in every dictionary, not only the one that filled it, until some
+// chunks are released. It is not locked either, so dictionaries built with handles
+// must all be used from one thread (or behind one lock).
+#ifdef _DICT_ARENA_OFFSETS
+#ifndef _DICT_ARENA
+#error "_DICT_ARENA_OFFSETS needs _DICT_ARENA"
+#endif
+#if _DICT_ARENA_OFFSETS == 16
+#define _DICT_REF_TYPE  uint16_t
+#elif _DICT_ARENA_OFFSETS == 32
+#define _DICT_REF_TYPE  uint32_t
+#else
+#error "_DICT_ARENA_OFFSETS must be 16 or 32"
+#endif
+#if (_DICT_ARENA_CHUNK & (_DICT_ARENA_CHUNK - 1)) != 0 || _DICT_ARENA_CHUNK < 256 || _DICT_ARENA_CHUNK > 65536
+#error "_DICT_ARENA_OFFSETS needs _DICT_ARENA_CHUNK to be a power of two from 256 to 65536"
+#endif
+#endif
+
+// The most pairs a dictionary holds. Every node keeps its position in the
+// positional array (key(i), value(i)) so remove() can take it out in O(1), and
+// this sets the width of that field: 65535 or less makes it 16 bits, which fit
+// the node's padding on ESP32 and 64-bit hosts. 16-bit arena handles cannot reach
+// more nodes than that, so they default to it.
+#ifndef _DICT_MAX_PAIRS
+#if defined(_DICT_ARENA_OFFSETS) && _DICT_ARENA_OFFSETS == 16
+#define _DICT_MAX_PAIRS  UINT16_MAX
+#else
+#define _DICT_MAX_PAIRS  UINT32_MAX
+#endif
+#endif
+
+#if _DICT_MAX_PAIRS <= UINT16_MAX
+#define _DICT_SLOT_TYPE  uint16_t
+#elif _DICT_MAX_PAIRS <= UINT32_MAX
+#define _DICT_SLOT_TYPE  uint32_t
+#else
+#error "_DICT_MAX_PAIRS must be at most UINT32_MAX"
+#endif
+
+// Insertion order: #define _DICT_ORDERED links the nodes into a list in the order
+// they were inserted, and the list takes the place of the positional array.
+// key(i), value(i), json() and iteration then keep insertion order across removes;
+// a remove unlinks its node in O(1). Two links per node replace the array's
+// pointer and the node's position, and nothing is reallocated as the dictionary
+// grows. key(i) walks from the head, the tail or the last position read, so loops
+// over i are O(1) per step and random positions O(n).
+
+// Slab allocation: #define _DICT_SLAB serves nodes and key/value buffers from free
+// lists kept by the dictionary, one per size class: the node, and strings of 8, 16,
+// 32, 64, 128 and 256 bytes (a longer one comes from the heap). A class takes
+// memory from the heap _DICT_SLAB_PAGE bytes at a time; a removed node and its
+// buffers go back to the lists and later inserts reuse them, so steady churn stops
+// allocating. A value is updated in place while it stays in its size class.
+// destroy() frees the pages.
+#ifdef _DICT_SLAB
+#ifndef _DICT_SLAB_PAGE
+#define _DICT_SLAB_PAGE  256
+#endif
+#endif
+
+// Value tiers: #define _DICT_TIERS counts search() hits per node, on one lookup in
+// _DICT_TIERS_SAMPLE (a power of two, chosen at random so that a periodic access
+// pattern cannot hide a key), and adds rebalanceTiers(budget): the values of the
+// most-hit nodes, up to budget bytes, move to DICT_MEM_HOT (internal RAM by
+// default), all others to DICT_MEM_VALUE, and the counts are halved so that they
+// follow recent use. Values stay where they are between calls.
+#ifdef _DICT_TIERS
+#ifndef _DICT_TIERS_SAMPLE
+#define _DICT_TIERS_SAMPLE  4
+#endif
+#if (_DICT_TIERS_SAMPLE & (_DICT_TIERS_SAMPLE - 1)) != 0 || _DICT_TIERS_SAMPLE > 256
+#error "_DICT_TIERS_SAMPLE must be a power of two, up to 256"
+#endif
+#if defined(_DICT_SINGLE_ALLOC) || defined(_DICT_ARENA) || defined(_DICT_SLAB)
+#error "_DICT_TIERS needs values in buffers of their own: not with _DICT_SINGLE_ALLOC, _DICT_ARENA or _DICT_SLAB"
+#endif
+#endif
+
+// _DICT_NODE_BLOCK: a node's key and value bytes follow it in the same block.
+#ifdef _DICT_NODE_BLOCK
+#define _DICT_NODE_ALIGN  8
+#endif
+
+#if (defined(_DICT_SSO) || defined(_DICT_SLAB)) && defined(_DICT_NODE_BLOCK)
+#error "select only one of _DICT_SSO, _DICT_SINGLE_ALLOC, _DICT_ARENA and _DICT_SLAB"
+#endif
+#if (defined(_DICT_SINGLE_ALLOC) && defined(_DICT_ARENA)) || (defined(_DICT_SSO) && defined(_DICT_SLAB))
+#error "select only one of _DICT_SSO, _DICT_SINGLE_ALLOC, _DICT_ARENA and _DICT_SLAB"
+#endif
+
 #if defined(_DICT_COMPRESS_SHOCO)
 
 #define _DICT_COMPRESS
@@ -246,6 +590,89 @@ extern "C" {
 #include "BufferStream/BufferStream.h"
 
 
+// Memory regions: every block the dictionary allocates is tagged with what it
+// holds, so an allocation policy can place the structures a lookup walks (nodes,
+// keys, index) apart from the bulky value bytes.
+#define DICT_MEM_NODE   0x01    // nodes (and arena chunks, slab pages)
+#define DICT_MEM_KEY    0x02    // key buffers
+#define DICT_MEM_VALUE  0x04    // value buffers
+#define DICT_MEM_INDEX  0x08    // positional array, hash/ART/btree/bloom/frozen index, scratch buffers
+#define DICT_MEM_ALL    0x0F
+#define DICT_MEM_HOT    0x10    // value buffers promoted by rebalanceTiers() (_DICT_TIERS)
+
+// Regions the default policy takes from PSRAM with _DICT_USE_PSRAM (when the board
+// has it); the others come from internal RAM. E.g. #define _DICT_PSRAM_REGIONS
+// DICT_MEM_VALUE keeps traversal in internal RAM and only the values in PSRAM.
+// DICT_MEM_HOT is not part of DICT_MEM_ALL: hot values stay in internal RAM.
+#ifndef _DICT_PSRAM_REGIONS
+#define _DICT_PSRAM_REGIONS  DICT_MEM_ALL
+#endif
+
+// Allocation policy: alloc() returns NULL when out of memory; free() gets the region
+// the block was allocated for. Shared by all dictionaries - install it with
+// Dictionary::setAllocator() before any dictionary allocates.
+struct DictionaryAllocator {
+  void* (*alloc)(size_t size, uint8_t region);
+  void  (*free)(void* p, uint8_t region);
+};
+
+void* dictAlloc(size_t size, uint8_t region);
+void  dictFree(void* p, uint8_t region);
+
+#ifdef _DICT_SLAB
+class NodeSlab;
+#endif
+#ifdef _DICT_ARENA
+class NodeArena;
+#endif
+
+#if defined(_DICT_ARENA_OFFSETS) && defined(_DICT_ENGINE_TREE)
+class node;
+
+// A child link held as an arena handle (see _DICT_ARENA_OFFSETS). It reads and is
+// assigned like the node* it stands for, so the tree code is the same in both modes.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) nodeRef {
+#else
+class nodeRef {
+#endif
+  public:
+    inline nodeRef& operator = (node* n);
+    inline operator node* () const;
+    inline node* operator -> () const;
+
+  private:
+    _DICT_REF_TYPE  h;        // 0 is NULL
+};
+#endif
+
+class Dictionary;
+
+// Walks a dictionary's pairs by position (insertion order with _DICT_ORDERED):
+//   for (auto& e : d) Serial.println(e.key() + " = " + e.value());
+// The dictionary must not be modified during the walk.
+class DictionaryIterator {
+  public:
+    DictionaryIterator(Dictionary* d, size_t i) : iDict(d), iPos(i) {}
+
+    String          key();
+    String          value();
+    inline size_t   index() const { return iPos; }
+
+    inline DictionaryIterator& operator * () { return *this; }
+    inline DictionaryIterator& operator ++ () { iPos++; return *this; }
+    inline bool operator != (const DictionaryIterator& b) const { return iPos != b.iPos; }
+
+  private:
+    Dictionary*     iDict;
+    size_t          iPos;
+};
+
+// forEachPrefix() callback: one call per matching key-value pair. The dictionary
+// must not be modified from inside the callback.
+typedef void (*DictionaryCallback)(const String& key, const String& value, void* ctx);
+
+
 #ifdef _DICT_PACK_STRUCTURES
 class __attribute((__packed__)) node {
 #else
@@ -253,16 +680,22 @@ class node {
 #endif
   public:
 
-    void* operator new(size_t size) {
+    // Nodes are created with new (keylen, vallen) node (with _DICT_ARENA, from the
+    // dictionary's arena instead). In single-allocation mode the key and value bytes
+    // are part of the node's block; otherwise the sizes are not needed and create()
+    // allocates the buffers. noexcept: it returns NULL when out of memory, and the
+    // callers' NULL checks must not be optimized away.
+    void* operator new(size_t size, _DICT_KEY_TYPE aKeySize, _DICT_VAL_TYPE aValSize) noexcept {
+#ifdef _DICT_NODE_BLOCK
+      size = blockSize(aKeySize, aValSize);
+#else
+      (void) aKeySize;
+      (void) aValSize;
+#endif
 
       void* p = NULL;
       if ( size ) {
-#if defined (ARDUINO_ARCH_ESP32) && defined(_DICT_USE_PSRAM)
-        if (psramFound()) {
-          p = ps_malloc(size);
-        }
-#endif
-        if (!p) p = malloc(size);
+        p = dictAlloc(size, DICT_MEM_NODE);
 #ifdef _LIBDEBUG_
         Serial.printf("NODE-NEW: size=%d (%d) k/v sizes=%d, %d, ptr=%u\n", size, sizeof(node), sizeof(_DICT_KEY_TYPE), sizeof(_DICT_VAL_TYPE), (uint32_t)p);
 #endif    
@@ -272,47 +705,222 @@ class node {
 
     void operator delete(void* p) {
       if ( p == NULL ) return;
+#if defined(_DICT_SSO)
+      node* n = (node*)p;
+
+      // Delete key/value strings that are not stored inline
+      if ( n->ksize > _DICT_SSO_LEN ) dictFree(n->keybuf, DICT_MEM_KEY);
+      if ( n->vsize > _DICT_SSO_LEN ) dictFree(n->valbuf, n->valRegion());
+#elif defined(_DICT_ARENA)
+      // The block, and any bytes a value has moved to, belong to the arena.
+      return;
+#elif !defined(_DICT_SINGLE_ALLOC)
       node* n = (node*)p;
 
       // Delete key/value strings
       if ( n->keybuf ) { 
-        free(n->keybuf);
+        dictFree(n->keybuf, DICT_MEM_KEY);
         n->keybuf = NULL;
       }
       if ( n->valbuf ) {
-          free(n->valbuf);
+          dictFree(n->valbuf, n->valRegion());
           n->valbuf = NULL;
       }
-      free(p);
+#endif
+      dictFree(p, DICT_MEM_NODE);
 #ifdef _LIBDEBUG_
       Serial.printf("NODE-DELETE: Freed memory block %u\n", (uint32_t)p);
 #endif    
     }
 
+    void operator delete(void* p, _DICT_KEY_TYPE, _DICT_VAL_TYPE) {
+      operator delete(p);
+    }
+
+#ifdef _DICT_NODE_BLOCK
+    // Bytes of the block holding a node with a key and value of these sizes.
+    static size_t blockSize(_DICT_KEY_TYPE aKeySize, _DICT_VAL_TYPE aValSize) {
+      size_t ks = aKeySize < sizeof(uintNN_t) ? sizeof(uintNN_t) : aKeySize;
+      size_t vs = (aValSize + _DICT_EXTRA) == 0 ? 1 : aValSize + _DICT_EXTRA;
+      size_t sz = sizeof(node) + ks + _DICT_EXTRA + vs;
+      return (sz + _DICT_NODE_ALIGN - 1) & ~(size_t)(_DICT_NODE_ALIGN - 1);
+    }
+#endif
+
     uintNN_t    key() {
+#ifdef _DICT_ENGINE_TREE
+        return hkey;
+#else
         uintNN_t k = 0;
         
-        memcpy((void*)&k, keybuf, ksize < sizeof(uintNN_t) ? ksize : sizeof(uintNN_t));
+        memcpy((void*)&k, kbuf(), ksize < sizeof(uintNN_t) ? ksize : sizeof(uintNN_t));
         return k;
+#endif
+    }
+
+    // The key and value bytes (NUL-terminated unless compressed).
+#ifdef _DICT_SSO
+    inline char* kbuf() const { return ksize <= _DICT_SSO_LEN ? (char*)keyinl : keybuf; }
+    inline char* vbuf() const { return vsize <= _DICT_SSO_LEN ? (char*)valinl : valbuf; }
+#elif defined(_DICT_ARENA_OFFSETS)
+    inline char* kbuf() const { return (char*)(this + 1); }
+    inline char* vbuf() const;
+#else
+    inline char* kbuf() const { return keybuf; }
+    inline char* vbuf() const { return valbuf; }
+#endif
+#ifdef _DICT_TIERS
+    inline uint8_t valRegion() const { return vhot ? DICT_MEM_HOT : DICT_MEM_VALUE; }
+    // Bytes of the value's own buffer, 0 if it has none (an inline value).
+    inline size_t  valBytes() const {
+#ifdef _DICT_SSO
+      if ( vsize <= _DICT_SSO_LEN ) return 0;
+#endif
+      return (vsize + _DICT_EXTRA) == 0 ? 1 : vsize + _DICT_EXTRA;
     }
+    // Move the value's buffer to DICT_MEM_HOT (aHot) or DICT_MEM_VALUE.
+    int8_t      moveValue(uint8_t aHot);
+#else
+    inline uint8_t valRegion() const { return DICT_MEM_VALUE; }
+#endif
     
-    int8_t      create(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize, node* aLeft, node* aRight);
+    // aHash is Dictionary::crc() of the key; the tree engine keeps it in the node.
+#ifdef _DICT_SLAB
+    // The buffers come from (and go back to) the dictionary's slab.
+    int8_t      create(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize, uintNN_t aHash, NodeSlab* aSlab);
+    int8_t      updateValue(const char* aVal, _DICT_VAL_TYPE aValSize, NodeSlab* aSlab);
+#elif defined(_DICT_ARENA)
+    int8_t      create(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize, uintNN_t aHash);
+    // A value that outgrows its place moves to new bytes of the dictionary's arena.
+    int8_t      updateValue(const char* aVal, _DICT_VAL_TYPE aValSize, NodeArena* aArena);
+#else
+    int8_t      create(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize, uintNN_t aHash);
     int8_t      updateValue(const char* aVal, _DICT_VAL_TYPE aValSize);
-    int8_t      updateKey(const char* aKey, _DICT_KEY_TYPE aKeySize);
-    // Atomically replace both key and value; on failure the node is left unchanged.
-    int8_t      updateKeyValue(const char* aKey, _DICT_KEY_TYPE aKeySize, const char* aVal, _DICT_VAL_TYPE aValSize);
+#endif
+#if defined(_DICT_SINGLE_ALLOC)
+    // A copy of this node (key, links) with a new value, in a block big enough
+    // for it; NULL if out of memory. This node is left unchanged.
+    node*       resized(const char* aVal, _DICT_VAL_TYPE aValSize);
+#endif
 
 #ifdef _LIBDEBUG_
     void printNode();
 #endif
-    char*           keybuf;
-    _DICT_KEY_TYPE  ksize;
-    char*           valbuf;
-    _DICT_VAL_TYPE  vsize;
+#ifdef _DICT_ENGINE_TREE
+    // All a tree walk reads at a level that is not the key's own, so they lead
+    // the node and share its first cache line; the key bytes are only read when
+    // two "crc" values are equal.
+#ifdef _DICT_ARENA_OFFSETS
+    nodeRef         left;
+    nodeRef         right;
+#else
     node*           left;
     node*           right;
+#endif
+    uintNN_t        hkey;     // the key's crc(): full-key hash, or its first bytes
+#endif
+#ifndef _DICT_ORDERED
+    _DICT_SLOT_TYPE slot;     // position in the dictionary's NodeArray
+#endif
+    // The lengths and one-byte fields sit together, after the walk fields and
+    // ahead of the buffers: the natural layout then has no padding inside it and
+    // is as small as a packed one, short of rounding at the end.
+    _DICT_KEY_TYPE  ksize;
+#ifdef _DICT_BALANCED
+    uint8_t         height;   // AVL subtree height (leaf = 1)
+#endif
+    _DICT_VAL_TYPE  vsize;
+#ifdef _DICT_NODE_BLOCK
+    _DICT_VAL_TYPE  vcap;     // value bytes that fit in the block
+#endif
+#ifdef _DICT_TIERS
+    uint8_t         hits;     // sampled search() hits, halved by rebalanceTiers()
+    uint8_t         vhot;     // the value buffer is in DICT_MEM_HOT
+#endif
+#ifdef _DICT_SSO
+    union {
+      char*         keybuf;   // ksize > _DICT_SSO_LEN
+      char          keyinl[_DICT_SSO_LEN + _DICT_EXTRA];
+    };
+    union {
+      char*         valbuf;   // vsize > _DICT_SSO_LEN
+      char          valinl[_DICT_SSO_LEN + _DICT_EXTRA];
+    };
+#elif defined(_DICT_ARENA_OFFSETS)
+    // The key follows the node; the value follows the key until it outgrows vcap.
+#ifdef _DICT_ENGINE_TREE
+    _DICT_REF_TYPE  self;     // this node's own handle, stored in the links to it
+#endif
+    _DICT_REF_TYPE  vref;     // 0: the value is in the block; else the handle of its bytes
+#else
+    char*           keybuf;
+    char*           valbuf;
+#endif
+#ifdef _DICT_ORDERED
+    node*           prev;     // insertion order, walked by NodeArray
+    node*           next;
+#endif
+};
+
+#ifdef _DICT_ORDERED
+// Positional array of the nodes (key(i), value(i)) as the list of node::prev and
+// node::next, in insertion order. operator[] starts from the head, the tail or
+// the last position it returned, whichever is nearest, so sequential reads are O(1).
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) NodeArray {
+#else
+class NodeArray {
+#endif
+  public:
+    // init the queue (constructor).
+    NodeArray(size_t init_size = 10);
+
+    // clear the queue (destructor).
+    ~NodeArray();
+
+    // add an item to the queue.
+    int8_t append(const node* i);
+
+    // remove an item from the queue.
+    void remove(const node* i);
+
+#ifdef _DICT_SINGLE_ALLOC
+    // put n in the place of item i.
+    void replace(const node* i, const node* n);
+#endif
+
+    // check if the queue is empty.
+    bool isEmpty() const;
+
+    //    // get the number of items in the queue.
+    size_t count() const;
+
+    // check if the queue is full.
+    bool isFull() const;
+
+    node* operator [] (const size_t i);
+
+#ifdef _LIBDEBUG_
+    void printArray();
+#endif
+
+  private:
+    node*     head;
+    node*     tail;
+    node*     cur;        // the node operator[] returned last, or NULL
+    size_t    curIndex;   // and its position
+    size_t    items;      // the number of items of the queue.
 };
 
+#else
+// Positional array of the nodes (key(i), value(i)). The pointers are kept in
+// segments of a fixed number of slots, found through a small directory: growing
+// adds a segment and never copies the array, so there is no moment when an old
+// and a new array are both allocated, and segments emptied by removes are freed
+// (one spare is kept). The segment size is the initial size rounded up to a power
+// of two, from 8 to 256 slots. Each node holds its own position (node::slot):
+// remove() moves the last node into the freed place, so it is O(1) and the other
+// positions do not change.
 #ifdef _DICT_PACK_STRUCTURES
 class __attribute((__packed__)) NodeArray {
 #else
@@ -331,6 +939,11 @@ class NodeArray {
     // remove an item from the queue.
     void remove(const node* i);
 
+#ifdef _DICT_SINGLE_ALLOC
+    // put n in the place of item i.
+    void replace(const node* i, const node* n);
+#endif
+
     // check if the queue is empty.
     bool isEmpty() const;
 
@@ -346,30 +959,505 @@ class NodeArray {
         //        exit ("QUEUE: Out of bounds");
         return NULL;
       }
-      return contents[i];
+      return at(i);
     }
 
+    // log2 of the slots per segment of an array made with init_size.
+    static uint8_t segmentShift(size_t init_size);
+
 #ifdef _LIBDEBUG_
     void printArray();
 #endif
 
   private:
-    // resize the size of the queue.
-    int8_t resize(const size_t s);
+    inline node*& at(size_t i) const { return dir[i >> shift][i & (((size_t)1 << shift) - 1)]; }
+
+    // free the segments past the one the items end in, and one spare.
+    void trim();
+
+    node***   dir;        // the segments
+    size_t    dirSize;    // slots in dir
+    size_t    segs;       // segments allocated: dir[0] to dir[segs - 1]
+    size_t    items;      // the number of items of the queue.
+    uint8_t   shift;      // log2 of the slots per segment
+};
+#endif // _DICT_ORDERED
+
+
+#ifdef _DICT_ENGINE_HASH
+// Open-addressing hash index (Robin Hood probing, power-of-two capacity).
+// Slots cache the full key hash, so probes compare 4 bytes and only touch the
+// node on a hash match. Growth is incremental: a resize allocates the bigger
+// table and then every insert/remove migrates a few old slots, so no single
+// call has to rehash the whole dictionary.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) NodeHash {
+#else
+class NodeHash {
+#endif
+  public:
+    NodeHash(size_t init_size = 10);
+    ~NodeHash();
+
+    // add a node that is known not to be present yet.
+    int8_t insert(node* n, uintNN_t h);
+
+    // find the node for a key, or NULL.
+    node*  find(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+
+    // unlink the node for a key and return it (NULL if absent).
+    node*  remove(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+
+#ifdef _DICT_SINGLE_ALLOC
+    // point the entry for n's key at n, a moved copy of the node indexed now.
+    void   relink(node* n, uintNN_t h);
+#endif
+
+  private:
+    struct slot {
+      node*     n;
+      uintNN_t  h;
+    };
+
+    size_t  probe(const slot* tab, size_t mask, uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+    void    place(slot* tab, size_t mask, node* n, uintNN_t h);
+    int8_t  grow();
+    void    migrate(size_t steps);
+
+    size_t  initialSize;
+
+    slot*   table;      // current table
+    size_t  mask;       // capacity - 1
+    size_t  items;      // live nodes in table
+
+    slot*   old;        // table being drained by an incremental resize (or NULL)
+    size_t  oldMask;
+    size_t  oldItems;
+    size_t  cursor;     // next old slot to migrate
+};
+#endif
+
+#ifdef _DICT_ENGINE_ART
+// Adaptive radix tree index (Leis et al., "The Adaptive Radix Tree", ICDE 2013).
+// Inner nodes branch on one key byte and come in four sizes (4, 16, 48 and 256
+// children) that grow as children are added; a run of bytes shared by every key
+// below a node is stored once in that node (path compression). A child that is
+// the only key on its path points straight at the dictionary node (lazy
+// expansion), and a key that ends inside the tree hangs off the inner node where
+// it ends. Lookups cost O(key length), whatever the number of keys. Nodes are not
+// shrunk on remove; a node is freed once it has no children and no key left.
+// (Not packed: its only member is the root pointer, whose address is taken.)
+class NodeArt {
+  public:
+    NodeArt(size_t init_size = 10);
+    ~NodeArt();
+
+    // add a node that is known not to be present yet (the hash is not used).
+    int8_t insert(node* n, uintNN_t h);
+
+    // find the node for a key, or NULL.
+    node*  find(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+
+    // unlink the node for a key and return it (NULL if absent).
+    node*  remove(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+
+#ifdef _DICT_SINGLE_ALLOC
+    // point the entry for n's key at n, a moved copy of the node indexed now.
+    void   relink(node* n, uintNN_t h);
+#endif
+
+    // visit every node whose key starts with prefix, in key byte order. Returns
+    // the number visited, or (size_t)-1 if the walk could not get its memory.
+    size_t forEachPrefix(const char* prefix, size_t plen, DictionaryCallback cb, void* ctx);
+
+  private:
+    void   prune(void* n, const char* keystr);
+
+    void*  root;        // inner node, tagged leaf node*, or NULL
+};
+#endif
+
+#ifdef _DICT_ENGINE_BTREE
+// B-tree index (Bayer & McCreight; deletion as in Cormen et al.). Every node holds
+// up to _DICT_BTREE_ORDER - 1 dictionary nodes in key order, with their uintNN_t
+// key prefixes in a separate array: a level is searched by scanning that array
+// (with SSE2 for 32-bit prefixes) and only prefix ties read the keys themselves.
+// Every node but the root is at least half full, so a lookup visits about
+// log(n) / log(_DICT_BTREE_ORDER / 2) nodes. Full nodes are split on the way down
+// and thin ones refilled on the way down, so neither insert nor remove revisits
+// a level, and remove never allocates.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) NodeBtree {
+#else
+class NodeBtree {
+#endif
+  public:
+    NodeBtree(size_t init_size = 10);
+    ~NodeBtree();
+
+    // add a node that is known not to be present yet.
+    int8_t insert(node* n, uintNN_t h);
+
+    // find the node for a key, or NULL.
+    node*  find(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+
+    // unlink the node for a key and return it (NULL if absent).
+    node*  remove(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+
+#ifdef _DICT_SINGLE_ALLOC
+    // point the entry for n's key at n, a moved copy of the node indexed now.
+    void   relink(node* n, uintNN_t h);
+#endif
+
+  private:
+    void*  root;        // nodeBtree (see Dictionary.h), or NULL when empty
+};
+#endif
+
+#ifdef _DICT_ENGINE_SWISS
+// Group-probing hash index in the style of Abseil's Swiss tables. Every slot has
+// a control byte (empty, deleted, or a 7-bit tag from the key hash); control
+// bytes come in groups of 16 that are matched against the tag all at once, so a
+// typical lookup reads one 16-byte control group and compares one key. Groups are
+// probed triangularly; the table is rehashed when it would pass 7/8 full.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) NodeSwiss {
+#else
+class NodeSwiss {
+#endif
+  public:
+    NodeSwiss(size_t init_size = 10);
+    ~NodeSwiss();
+
+    // add a node that is known not to be present yet.
+    int8_t insert(node* n, uintNN_t h);
+
+    // find the node for a key, or NULL.
+    node*  find(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+
+    // unlink the node for a key and return it (NULL if absent).
+    node*  remove(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+
+#ifdef _DICT_SINGLE_ALLOC
+    // point the entry for n's key at n, a moved copy of the node indexed now.
+    void   relink(node* n, uintNN_t h);
+#endif
+
+  private:
+    size_t    locate(uintNN_t h, const char* keystr, _DICT_KEY_TYPE keylen);
+    size_t    freeSlot(uintNN_t h);
+    int8_t    rehash(size_t groups);
+
+    size_t    initialSize;
+
+    node**    slots;      // capacity node pointers, followed by...
+    uint8_t*  ctrl;       // ...capacity control bytes (same allocation)
+    size_t    gmask;      // number of groups - 1 (groups is a power of two)
+    size_t    items;      // live nodes
+    size_t    growthLeft; // inserts into empty slots left before a rehash
+};
+#endif
+
+
+#ifdef _DICT_BLOOM
+// Counting Bloom filter over the (stored) keys, split into 64-byte blocks of 128
+// 4-bit counters. A key hashes to one block and to 4 counters in it, so a check
+// reads one cache line. Counters saturate at 15 and are then never decremented,
+// so removing keys can leave false positives but never false negatives.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) NodeBloom {
+#else
+class NodeBloom {
+#endif
+  public:
+    NodeBloom(size_t init_size = 10);
+    ~NodeBloom();
+
+    // count a new key. d holds every key, this one included, and is re-read when
+    // the filter has to grow.
+    void   add(const char* keystr, _DICT_KEY_TYPE keylen, Dictionary* d);
+
+    // uncount a key that was added before.
+    void   remove(const char* keystr, _DICT_KEY_TYPE keylen);
 
-    // exit report method in case of error.
-    //    void exit (const char * m) const;
+    // false if the key is certainly not present.
+    bool   mayContain(const char* keystr, _DICT_KEY_TYPE keylen);
 
-    // the initial size of the queue.
-    size_t initialSize;
+  private:
+    void   update(const char* keystr, _DICT_KEY_TYPE keylen, int8_t delta);
+    int8_t rebuild(Dictionary* d);
 
-    node** contents;    // the array of the queue.
+    size_t    initialSize;
 
-    size_t size;        // the size of the queue.
-    size_t items;       // the number of items of the queue.
-    size_t tail;        // the tail of the queue.
+    uint8_t*  counters;   // blocks x 64 bytes, two counters per byte
+    size_t    mask;       // number of blocks - 1 (a power of two)
+    size_t    items;      // keys counted
 };
+#endif
+
+#ifdef _DICT_FLAT
+// Offsets and sizes in a NodeFlat block: 16 bits unless _DICT_FLAT_MAX entries of
+// the longest key and value may not fit in 64 KB.
+#if _DICT_FLAT_MAX * (_DICT_KEYLEN + _DICT_VALLEN + 48) <= 65535
+#define _DICT_FLAT_SIZE_TYPE  uint16_t
+#else
+#define _DICT_FLAT_SIZE_TYPE  uint32_t
+#endif
+
+// The pairs of a small dictionary (_DICT_FLAT), in one block: a table of the
+// entries in positional order - key "crc", lengths and where the bytes are - then
+// the key and value bytes. A lookup scans the table and reads an entry's key only
+// when its crc and length match. The block is allocated on first insert, grows as
+// pairs are added and is freed when the last one is removed.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) NodeFlat {
+#else
+class NodeFlat {
+#endif
+  public:
+    NodeFlat();
+    ~NodeFlat();
+
+    // position of the key, or count() if it is not present.
+    size_t   find(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen);
+
+    // store a pair at position i: a new last entry when i == count(), otherwise a
+    // new value for entry i. NODEARRAY_MEM leaves everything as it was.
+    int8_t   put(size_t i, uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen);
 
+    // drop entry i; the last entry moves into its place (with _DICT_ORDERED the
+    // later entries move up one place instead).
+    void     remove(size_t i);
+
+    // stored key and value of entry i (any pointer may be NULL); false if i is out of range.
+    bool     entry(size_t i, const char** k, _DICT_KEY_TYPE* kl, const char** v, _DICT_VAL_TYPE* vl);
+    uintNN_t key(size_t i) { return table()[i].key; }
+
+    size_t   count() const { return items; }
+    size_t   size() const { return cap; }
+
+  private:
+#ifdef _DICT_PACK_STRUCTURES
+    struct __attribute((__packed__)) item {
+#else
+    struct item {
+#endif
+      uintNN_t              key;
+      _DICT_FLAT_SIZE_TYPE  offset;   // of the key in the data; the value follows it
+      _DICT_KEY_TYPE        ksize;
+      _DICT_VAL_TYPE        vsize;
+    };
+
+    item*    table() { return (item*) block; }
+    char*    data() { return block + items * sizeof(item); }
+    // move the table and data to a block of size bytes; false if out of memory.
+    bool     fit(size_t size);
+    // move the data from offset `from` on to offset `to`, fixing the offsets.
+    void     shift(size_t from, size_t to);
+
+    char*                 block;
+    _DICT_FLAT_SIZE_TYPE  used;     // bytes of key/value data
+    _DICT_FLAT_SIZE_TYPE  cap;      // bytes of the block
+    uint8_t               items;
+};
+#endif
+
+#ifdef _DICT_ARENA
+#ifdef _DICT_ARENA_OFFSETS
+constexpr uint8_t dictLog2(size_t x) { return x > 1 ? 1 + dictLog2(x >> 1) : 0; }
+#endif
+
+// Bump allocator for the nodes of one dictionary. Chunks of _DICT_ARENA_CHUNK bytes
+// (or one chunk for a bigger request) form a list; alloc() takes the next bytes of
+// the current chunk and moves on to the following one when it is full. reset()
+// rewinds to the first chunk without freeing anything, so a reload fills the same
+// chunks again; release() frees them.
+// With _DICT_ARENA_OFFSETS every chunk also has a number in a directory shared by
+// all arenas, so that a handle (number, offset) leads back to its bytes. Its size
+// limits all arenas together, and nothing guards it against other threads.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) NodeArena {
+#else
+class NodeArena {
+#endif
+  public:
+    NodeArena();
+    ~NodeArena();
+
+    // size bytes aligned to _DICT_NODE_ALIGN, or NULL if out of memory.
+#ifdef _DICT_ARENA_OFFSETS
+    // The bytes' handle goes to *ref; NULL also when no chunk number is left.
+    void*  alloc(size_t size, _DICT_REF_TYPE* ref);
+
+    // The bytes a handle stands for (NULL for 0).
+    static inline void* address(_DICT_REF_TYPE ref) {
+      return dir[ref >> OFFSET_BITS] + ((size_t)(ref & OFFSET_MASK) << 3);
+    }
+#else
+    void*  alloc(size_t size);
+#endif
+
+    // forget every allocation and keep the chunks.
+    void   reset();
+
+    // free every chunk.
+    void   release();
+
+  private:
+    struct chunk {
+      chunk*  next;
+      size_t  cap;        // bytes after the header
+      size_t  used;
+#ifdef _DICT_ARENA_OFFSETS
+      uint32_t id;        // number in dir
+#endif
+    };
+    // chunk header rounded up so the bytes after it are aligned too
+    static const size_t HEADER = (sizeof(chunk) + _DICT_NODE_ALIGN - 1) & ~(size_t)(_DICT_NODE_ALIGN - 1);
+
+#ifdef _DICT_ARENA_OFFSETS
+    static const uint8_t   OFFSET_BITS = dictLog2(_DICT_ARENA_CHUNK / 8);
+    static const uint32_t  OFFSET_MASK = ((uint32_t)1 << OFFSET_BITS) - 1;
+    static const uint32_t  MAX_ID = (uint32_t)(((uint64_t)1 << (_DICT_ARENA_OFFSETS - OFFSET_BITS)) - 1);
+
+    // Number a new chunk (0 if none is left or the directory cannot grow), and
+    // give a released chunk's number back.
+    static uint32_t  enroll(chunk* c);
+    static void      retire(uint32_t id);
+
+    static char**    dir;       // chunk of each number; entry 0 is NULL, free entries link the free numbers
+    static uint32_t  dirSize;   // numbers handed out so far, plus 1
+    static uint32_t  dirCap;
+    static uint32_t  dirFree;   // a free number below dirSize, 0 if none
+    static uint32_t  dirLive;   // chunks enrolled
+#endif
+
+    chunk*    head;
+    chunk*    cur;        // the chunk allocations come from
+};
+#endif
+
+#ifdef _DICT_SLAB
+// Size-class allocator for the nodes and strings of one dictionary. Class 0 is the
+// node, class i > 0 strings of 8 << (i - 1) bytes. Each class carves objects out of
+// pages of _DICT_SLAB_PAGE bytes (at least one object per page) and keeps released
+// ones in a free list linked through their first bytes. Pages are only freed by
+// clear(); strings longer than LARGEST bytes bypass the classes.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) NodeSlab {
+#else
+class NodeSlab {
+#endif
+  public:
+    NodeSlab();
+    ~NodeSlab();
+
+    static const size_t LARGEST = 256;
+
+    // bytes actually reserved for a string of size bytes.
+    static size_t capacity(size_t size);
+
+    // a string buffer of size bytes, or NULL if out of memory. region is where a
+    // string too long for the classes is allocated (pages are DICT_MEM_NODE).
+    void*  alloc(size_t size, uint8_t region);
+
+    // give back a buffer from alloc(); size is any size of the same class.
+    void   release(void* p, size_t size, uint8_t region);
+
+    node*  allocNode();
+    void   releaseNode(node* n);
+
+    // free every page (all objects are gone).
+    void   clear();
+
+  private:
+    static const uint8_t CLASSES = 7;
+
+    static uint8_t sizeClass(size_t size);    // of a string of at most LARGEST bytes
+    static size_t  objectSize(uint8_t c);
+    void*          take(uint8_t c);
+    void           give(void* p, uint8_t c);
+
+    void*     freeList[CLASSES];  // released objects
+    char*     carve[CLASSES];     // unused part of the class's newest page
+    size_t    left[CLASSES];      // objects that still fit there
+    char*     pages;              // every page, linked through its first bytes
+};
+#endif
+
+// Frozen dictionary index (see FrozenIndex below). By default the key hashes are
+// kept in sorted (Eytzinger) order and searched; with
+//
+// #define _DICT_FREEZE_MPH     // build a minimal perfect hash (CHD) over the keys:
+//                              // every lookup is one slot probe and one key compare.
+//                              // About 5 bytes of index per entry.
+//
+// _DICT_FREEZE_BUCKET is the average number of keys per CHD bucket: larger values
+// make the index smaller and the build slower.
+#ifdef _DICT_FREEZE_MPH
+#ifndef _DICT_FREEZE_BUCKET
+#define _DICT_FREEZE_BUCKET   4
+#endif
+#endif
+
+// Read-only copy of a dictionary made by Dictionary::freeze(). All keys and values
+// sit in one block (key, value, key, value... in positional order). By default the
+// key hashes are stored in Eytzinger (BFS) order: a lookup walks the implicit tree
+// k -> 2k / 2k+1 without branching on the comparison, and the next 4 levels below
+// k share one cache line, so they are prefetched while the current level is read.
+// With _DICT_FREEZE_MPH a per-bucket displacement table maps every key straight to
+// its slot instead.
+#ifdef _DICT_PACK_STRUCTURES
+class __attribute((__packed__)) FrozenIndex {
+#else
+class FrozenIndex {
+#endif
+  public:
+    FrozenIndex();
+    ~FrozenIndex();
+
+    // copy and index all pairs of the dictionary (nothing is changed on failure).
+    int8_t build(Dictionary* d);
+
+    // positional index of the key, or count() if it is not present.
+    size_t find(const char* keystr, _DICT_KEY_TYPE keylen);
+
+    // stored key and value of entry i (any pointer may be NULL); false if i is out of range.
+    bool   entry(size_t i, const char** k, _DICT_KEY_TYPE* kl, const char** v, _DICT_VAL_TYPE* vl);
+
+    size_t count() const { return items; }
+    size_t size() const { return bytes; }
+
+  private:
+#ifdef _DICT_PACK_STRUCTURES
+    struct __attribute((__packed__)) item {
+#else
+    struct item {
+#endif
+      uint32_t        offset;   // of the key in data; the value follows it
+      _DICT_KEY_TYPE  ksize;
+      _DICT_VAL_TYPE  vsize;
+    };
+
+    // lay out keys/order for the entries in list/data.
+    int8_t      index();
+
+    char*       block;      // single allocation holding all of the below
+#ifdef _DICT_FREEZE_MPH
+    uint32_t*   disp;       // [buckets] displacement, or FROZENINDEX_DIRECT | slot
+    size_t      buckets;
+    uint32_t    seed;       // key hash seed that gave a perfect hash
+    uint32_t*   order;      // [0..items-1] positional index of each slot
+#else
+    uintNN_t*   keys;       // [1..items] key hashes, Eytzinger order
+    uint32_t*   order;      // [1..items] positional index of each keys[] slot
+#endif
+    item*       list;       // [0..items-1] entries in positional order
+    char*       data;       // key/value bytes
+
+    size_t      items;
+    size_t      bytes;
+};
 
 
 #ifdef _DICT_PACK_STRUCTURES
@@ -405,6 +1493,37 @@ class Dictionary {
     int8_t              jload (Stream& json, int aNum = 0);
     int8_t              merge (Dictionary& dict);
 
+    // Convert to a read-only flat index: faster lookups, no per-entry allocations.
+    // insert/remove/jload then return DICTIONARY_ERR; destroy() makes it writable again.
+    int8_t              freeze();
+    int8_t              freeze(const String& json);     // jload() + freeze()
+    int8_t              freeze(Stream& json);
+    inline bool         frozen() { return F != NULL; }
+
+    // Call cb for every pair whose key starts with prefix ("" = all pairs); returns
+    // how many matched. Sorted by key on the ART engine, positional order otherwise.
+    size_t              forEachPrefix(const char* prefix, DictionaryCallback cb, void* ctx = NULL);
+    inline size_t       forEachPrefix(const String& prefix, DictionaryCallback cb, void* ctx = NULL) { return forEachPrefix(prefix.c_str(), cb, ctx); }
+
+    // Install the allocation policy of all dictionaries (NULL = the default). Blocks
+    // are freed through the policy that allocated them, so set it before use.
+    static void         setAllocator(const DictionaryAllocator* a);
+
+    // The key "crc" the index is built on, as the _DICT_HASH_* policy computes it.
+    static uintNN_t     crc(const void* data, size_t n_bytes);
+
+#ifdef _DICT_TIERS
+    // Move the values of the most-searched entries, up to budget bytes, to
+    // DICT_MEM_HOT and the others to DICT_MEM_VALUE. DICTIONARY_MEM if a value
+    // could not move (it stays readable where it was), DICTIONARY_ERR if frozen.
+    int8_t              rebalanceTiers(size_t budget);
+#endif
+
+#ifdef _DICT_BALANCED
+    // Levels of the node tree: at most ~1.44 log2(count()); 0 when there is no
+    // tree (empty, frozen, or still flat with _DICT_FLAT).
+    inline uint8_t      height() const { return iRoot ? iRoot->height : 0; }
+#endif
 
     void operator = (Dictionary& dict) {
       destroy();
@@ -424,7 +1543,14 @@ class Dictionary {
     String operator () (size_t i) { return key(i); }
     bool operator == (Dictionary& b);
     inline bool operator != (Dictionary& b) { return (!(*this == b)); }
-    inline size_t count() { return ( Q ? Q->count() : 0); }
+#ifdef _DICT_FLAT
+    inline size_t count() { return ( F ? F->count() : ( L ? L->count() : Q->count() ) ); }
+#else
+    inline size_t count() { return ( F ? F->count() : ( Q ? Q->count() : 0 ) ); }
+#endif
+
+    inline DictionaryIterator begin() { return DictionaryIterator(this, 0); }
+    inline DictionaryIterator end() { return DictionaryIterator(this, count()); }
 
 #ifdef _LIBDEBUG_
     void printNode(node* root);
@@ -441,12 +1567,55 @@ class Dictionary {
 
   private:
 // methods
-    int8_t              insert(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen, node* leaf);
-    node*               search(uintNN_t key, node* leaf, const char* keystr, _DICT_KEY_TYPE keylen);
+    // Engine-neutral index operations: every engine implements these three.
+    int8_t              insert(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen);
+    node*               search(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen);
+    int8_t              deleteNode(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen);
+
+    // A node holding the pair (from the arena with _DICT_ARENA), or NULL with the
+    // error in *rc.
+    node*               newNode(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen, int8_t* rc);
+
+    // Free a node and its strings (to the slab with _DICT_SLAB).
+    void                freeNode(node* n);
+
+    // New value for the node n found under key (an insert of an existing key).
+    int8_t              updateValue(node* n, uintNN_t key, const char* valstr, _DICT_VAL_TYPE vallen);
+#ifdef _DICT_SINGLE_ALLOC
+    void                relink(node* n, node* m, uintNN_t key);   // m replaces n everywhere
+#endif
 
+#ifdef _DICT_ENGINE_TREE
     node*               deleteNode(node* root, uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen);
+#endif
+
+#ifdef _DICT_BALANCED
+    void                rebalance(node** path, size_t depth);
+    node*               rotateLeft(node* n);
+    node*               rotateRight(node* n);
+    void                updateHeight(node* n);
+#endif
+
+#ifdef _DICT_SPLAY
+    node*               splay(node* t, uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen);
+#endif
+
+#ifdef _DICT_FLAT
+    int8_t              flatInsert(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen, const char* valstr, _DICT_VAL_TYPE vallen);
+    int8_t              flatDelete(uintNN_t key, const char* keystr, _DICT_KEY_TYPE keylen);
+    int8_t              promote();    // move the pairs into indexed nodes
+#endif
 
-    uintNN_t            crc(const void* data, size_t n_bytes);
+    // Stored (possibly compressed) key/value of entry i, from the nodes or the frozen block.
+    bool                entry(size_t i, const char** k, _DICT_KEY_TYPE* kl, const char** v, _DICT_VAL_TYPE* vl);
+
+#ifdef _DICT_ENGINE_SWISS
+    friend class NodeSwiss;   // rehashing recomputes crc() of stored keys
+#endif
+    friend class FrozenIndex; // the sorted layout indexes the keys by crc()
+#ifdef _DICT_BLOOM
+    friend class NodeBloom;   // a growing filter re-reads every key
+#endif
 
 #ifdef _DICT_COMPRESS
     int8_t              compressKey(const char* aStr);
@@ -456,16 +1625,44 @@ class Dictionary {
 #endif
 
 // data
+#ifdef _DICT_ENGINE_TREE
     node*               iRoot;
+#endif
+#ifdef _DICT_ENGINE_HASH
+    NodeHash*           H;
+#endif
+#ifdef _DICT_ENGINE_SWISS
+    NodeSwiss*          H;
+#endif
+#ifdef _DICT_ENGINE_ART
+    NodeArt*            H;
+#endif
+#ifdef _DICT_ENGINE_BTREE
+    NodeBtree*          H;
+#endif
     NodeArray*          Q;
+    FrozenIndex*        F;        // non-NULL once frozen (all nodes are then released)
+#ifdef _DICT_BLOOM
+    NodeBloom*          B;        // keys present, probably (see NodeBloom)
+#endif
+#ifdef _DICT_ARENA
+    NodeArena*          A;        // nodes, keys and values
+#endif
+#ifdef _DICT_SLAB
+    NodeSlab*           S;        // nodes, keys and values
+#endif
+#ifdef _DICT_TIERS
+    uint32_t            iTierRng; // picks the search() hits that are counted
+#endif
+#ifdef _DICT_FLAT
+    NodeFlat*           L;        // the pairs while not indexed, NULL once indexed
+#endif
     size_t              initSize;
 
     char*               iKeyTemp;
     _DICT_KEY_TYPE      iKeyLen;
     char*               iValTemp;
     _DICT_VAL_TYPE      iValLen;
-
-    int8_t              iError;   // out-of-band error from deleteNode (which returns node*)
 };
 
 #endif // #define _DICTIONARYDECLARATIONS_H_
@@ -0,0 +1,212 @@
+/*
+  Compile-time (constexpr) read-only dictionary for String key-value pairs.
+  Part of the Dictionary library.
+
+  ---
+
+  Copyright (C) Anatoli Arkhipenko, 2020
+  All rights reserved.
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+  ---
+
+  v3.7.0:
+    2026-10-16 - feature: StaticDictionary - a table of key/value literals that is
+                 hashed by the compiler and placed in read-only memory. Same lookup
+                 surface as Dictionary (search/key(i)/value(i)/json), no heap and
+                 no parsing at boot. Needs C++14.
+
+  Usage:
+
+    #include <StaticDictionary.h>
+
+    static constexpr auto defaults = makeStaticDictionary({
+      { "ssid",      "home" },
+      { "mqtt.host", "broker.lan" },
+      { "mqtt.port", "1883" },
+    });
+
+    String port = defaults["mqtt.port"];
+
+  A duplicate or empty key fails the build with an error naming
+  staticDictionaryDuplicateKey() / staticDictionaryEmptyKey().
+ */
+
+#ifndef _STATICDICTIONARY_H_
+#define _STATICDICTIONARY_H_
+
+#if __cplusplus < 201402L
+#error "StaticDictionary.h needs C++14 or later (e.g. -std=gnu++14)"
+#endif
+
+#include <Arduino.h>
+
+struct StaticPair {
+  const char* key = NULL;
+  const char* value = NULL;
+};
+
+// Called only when the table is invalid: they are not constexpr, so reaching one
+// while the compiler evaluates the constructor is a compile-time error.
+inline void staticDictionaryDuplicateKey() {}
+inline void staticDictionaryEmptyKey() {}
+inline void staticDictionaryTooLong() {}
+
+// Slots of the open-addressing table: a power of two at least twice the entries,
+// so linear probes stay short.
+constexpr size_t staticDictionarySlots(size_t n) {
+  size_t s = 2;
+  while (s < 2 * n) s *= 2;
+  return s;
+}
+
+constexpr size_t staticDictionaryLength(const char* s) {
+  size_t n = 0;
+  while (s[n]) n++;
+  return n;
+}
+
+// FNV-1a; the same function hashes the literals at compile time and the
+// searched key at run time.
+constexpr uint32_t staticDictionaryHash(const char* s, size_t n) {
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < n; i++) {
+    h ^= (uint8_t) s[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+constexpr bool staticDictionaryEqual(const char* a, const char* b, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+template <size_t N>
+class StaticDictionary {
+  public:
+    static_assert(N > 0 && N < UINT16_MAX, "StaticDictionary holds 1 to 65534 pairs");
+
+    constexpr StaticDictionary(const StaticPair (&aPairs)[N]) : pairs(), klen(), vlen(), table() {
+      for (size_t i = 0; i < N; i++) {
+        size_t kl = staticDictionaryLength(aPairs[i].key);
+        size_t vl = staticDictionaryLength(aPairs[i].value);
+        if (kl == 0) staticDictionaryEmptyKey();
+        if (kl >= UINT16_MAX || vl >= UINT16_MAX) staticDictionaryTooLong();
+
+        pairs[i] = aPairs[i];
+        klen[i] = (uint16_t) kl;
+        vlen[i] = (uint16_t) vl;
+
+        uint32_t h = staticDictionaryHash(aPairs[i].key, kl);
+        size_t   s = h & (SLOTS - 1);
+        while (table[s].index) {
+          size_t j = table[s].index - 1;
+          if (table[s].hash == h && klen[j] == kl && staticDictionaryEqual(pairs[j].key, aPairs[i].key, kl)) {
+            staticDictionaryDuplicateKey();
+          }
+          s = (s + 1) & (SLOTS - 1);
+        }
+        table[s].hash = h;
+        table[s].index = (uint16_t)(i + 1);
+      }
+    }
+
+    // positional index of the key, or count() if it is not present.
+    constexpr size_t find(const char* keystr, size_t keylen) const {
+      uint32_t h = staticDictionaryHash(keystr, keylen);
+      for (size_t s = h & (SLOTS - 1); table[s].index; s = (s + 1) & (SLOTS - 1)) {
+        size_t j = table[s].index - 1;
+        if (table[s].hash == h && klen[j] == keylen && staticDictionaryEqual(pairs[j].key, keystr, keylen)) return j;
+      }
+      return N;
+    }
+    constexpr size_t find(const char* keystr) const { return find(keystr, staticDictionaryLength(keystr)); }
+
+    String search(const char* keystr) const {
+      size_t i = find(keystr);
+      return (i < N) ? String(pairs[i].value) : String("");
+    }
+    inline String search(const String& keystr) const { return search(keystr.c_str()); }
+
+    String key(size_t i) const { return (i < N) ? String(pairs[i].key) : String(); }
+    String value(size_t i) const { return (i < N) ? String(pairs[i].value) : String(); }
+
+    constexpr size_t count() const { return N; }
+
+    // Same accounting as Dictionary::jsize() / esize().
+    size_t jsize() const {
+      size_t sz = 2 + N * 6;
+      for (size_t i = 0; i < N; i++) sz += klen[i] + vlen[i];
+      return sz;
+    }
+
+    size_t esize() const {
+      size_t sz = 0;
+      for (size_t i = 0; i < N; i++) sz += klen[i] + 1 + vlen[i] + 1;
+      return sz;
+    }
+
+    String json() const {
+      String s;
+
+      s.reserve(jsize());
+      s = '{';
+      for (size_t i = 0; i < N; i++) {
+        String kk = key(i);
+        String vv = value(i);
+        kk.replace("\\", "\\\\");
+        kk.replace("\"", "\\\"");
+        vv.replace("\\", "\\\\");
+        vv.replace("\"", "\\\"");
+        s += '"' + kk + "\":\"" + vv + '"';
+        if (i < N - 1) s += ',';
+      }
+      s += '}';
+      return s;
+    }
+
+    inline String operator [] (const String& keystr) const { return search(keystr); }
+    inline String operator [] (size_t i) const { return value(i); }
+    inline String operator () (size_t i) const { return key(i); }
+    inline bool   operator () (const String& keystr) const { return find(keystr.c_str(), keystr.length()) < N; }
+
+  private:
+    static constexpr size_t SLOTS = staticDictionarySlots(N);
+
+    struct slot {
+      uint32_t  hash = 0;
+      uint16_t  index = 0;    // entry + 1; 0 = empty
+    };
+
+    StaticPair  pairs[N];
+    uint16_t    klen[N];
+    uint16_t    vlen[N];
+    slot        table[SLOTS];
+};
+
+template <size_t N>
+constexpr size_t StaticDictionary<N>::SLOTS;
+
+// Deduces the number of pairs from a braced list: makeStaticDictionary({ {"k", "v"}, ... }).
+// The key/value literals are referenced, not copied.
+template <size_t N>
+constexpr StaticDictionary<N> makeStaticDictionary(const StaticPair (&aPairs)[N]) {
+  return StaticDictionary<N>(aPairs);
+}
+
+#endif // _STATICDICTIONARY_H_
@@ -0,0 +1,56 @@
+// bench-dictionary-bloom.cpp - host benchmark: search() hits and misses with and
+// without the Bloom filter. Built twice: bench_bloom_off (default tree) and
+// bench_bloom (_DICT_BLOOM). Misses are made like the ESP32 stress test's: the
+// stored keys contain a '-', the probed ones do not. Not part of ctest; run by hand:
+//
+//   ./build/bench_bloom_off && ./build/bench_bloom
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t LOOKUPS = 1000000;
+
+static double nsPerLookup(Dictionary& d, const std::vector<std::string>& keys, size_t& sink) {
+    std::mt19937 rng(42);
+    std::vector<const char*> q(LOOKUPS);
+    for (size_t i = 0; i < LOOKUPS; i++) q[i] = keys[rng() % keys.size()].c_str();
+
+    Clock::time_point t0 = Clock::now();
+    for (size_t i = 0; i < LOOKUPS; i++) sink += d.search(q[i]).length() + 1;
+    Clock::time_point t1 = Clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / LOOKUPS;
+}
+
+int main() {
+    size_t sink = 0;
+#ifdef _DICT_BLOOM
+    printf("Bloom filter: on (%d counters per key), %zu lookups per row\n", _DICT_BLOOM_BITS, LOOKUPS);
+#else
+    printf("Bloom filter: off, %zu lookups per row\n", LOOKUPS);
+#endif
+    printf("%8s %12s %12s\n", "keys", "hit ns", "miss ns");
+
+    const size_t sizes[] = { 100, 1000, 10000 };
+    for (size_t n : sizes) {
+        std::vector<std::string> hits, misses;
+        Dictionary d;
+        for (size_t i = 0; i < n; i++) {
+            std::string w = "word" + std::to_string(i * 7919 % 100003);
+            hits.push_back(w + "-" + std::to_string(i));
+            misses.push_back(w + std::to_string(i));
+            d.insert(hits.back().c_str(), std::to_string(i).c_str());
+        }
+
+        double hit = nsPerLookup(d, hits, sink);
+        double miss = nsPerLookup(d, misses, sink);
+        printf("%8zu %12.1f %12.1f\n", n, hit, miss);
+    }
+    return sink == 0;   // keep the lookups observable
+}
@@ -0,0 +1,74 @@
+// bench-dictionary-churn.cpp - host benchmark: a telemetry-style dictionary under
+// steady insert / update / remove churn, with nodes and strings from the heap
+// (default) and from the dictionary's slab (_DICT_SLAB). Built twice: bench_churn
+// and bench_churn_slab. malloc is wrapped (-Wl,--wrap=malloc) to count how many
+// allocations the churn still makes; heap use is glibc's count of bytes in
+// allocated chunks (mallinfo2) at the end. Not part of ctest; run by hand:
+//
+//   ./build/bench_churn && ./build/bench_churn_slab
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <chrono>
+#include <cstdio>
+#include <malloc.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+extern "C" void* __real_malloc(size_t);
+
+static size_t g_mallocs = 0;
+
+extern "C" void* __wrap_malloc(size_t n) {
+    g_mallocs++;
+    return __real_malloc(n);
+}
+
+static const size_t OPS = 1000000;
+
+int main() {
+#ifdef _DICT_SLAB
+    printf("nodes: slab, %d-byte pages (_DICT_SLAB)\n", _DICT_SLAB_PAGE);
+#else
+    printf("nodes: one heap block per node, key and value\n");
+#endif
+    printf("%8s %12s %16s %12s\n", "keys", "ns/op", "mallocs/1000 ops", "bytes/entry");
+
+    const size_t sizes[] = { 100, 1000, 10000 };
+    for (size_t n : sizes) {
+        // Metric names; values are readings of 1 to 24 characters.
+        std::vector<std::string> keys;
+        for (size_t i = 0; i < 2 * n; i++) keys.push_back("sensor/" + std::to_string(i * 7919 % 100003) + "/value");
+        std::string digits = "123456789.0123456789.0123";
+
+        size_t heap0 = mallinfo2().uordblks;
+        Dictionary* d = new Dictionary(2 * n);
+        std::mt19937 rng(42);
+        for (size_t i = 0; i < n; i++) d->insert(keys[i].c_str(), digits.substr(0, 1 + rng() % 24).c_str());
+
+        // Three operations in four store a reading under a random key of 2n (an
+        // update if the key is live, an insert if not), the fourth removes one, so
+        // the dictionary settles at about 1.5n keys.
+        std::vector<std::string> vals;
+        for (size_t i = 0; i < 64; i++) vals.push_back(digits.substr(0, 1 + rng() % 24));
+        size_t mallocs0 = g_mallocs;
+        Clock::time_point t0 = Clock::now();
+        for (size_t i = 0; i < OPS; i++) {
+            uint32_t r = rng();
+            const char* k = keys[r % (2 * n)].c_str();
+            if ((r >> 24) & 3) d->insert(k, vals[(r >> 16) & 63].c_str());
+            else               d->remove(k);
+        }
+        Clock::time_point t1 = Clock::now();
+        size_t mallocs = g_mallocs - mallocs0;
+        double perEntry = (double)(mallinfo2().uordblks - heap0) / d->count();
+
+        printf("%8zu %12.1f %16.1f %12.1f\n", n, std::chrono::duration<double, std::nano>(t1 - t0).count() / OPS,
+               1000.0 * mallocs / OPS, perEntry);
+        delete d;
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+// bench-dictionary-freeze.cpp - host benchmark: search() on a live dictionary
+// vs. the same keys after freeze(). Built twice: bench_freeze (Eytzinger layout)
+// and bench_freeze_mph (_DICT_FREEZE_MPH). Not part of ctest; run by hand:
+//
+//   ./build/bench_freeze && ./build/bench_freeze_mph
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t LOOKUPS = 1000000;
+
+// Lookup keys in a random order; values are short so String stays in SSO and
+// the timing is the index, not the allocator.
+static double nsPerLookup(Dictionary& d, const std::vector<std::string>& keys, size_t& sink) {
+    std::mt19937 rng(42);
+    std::vector<const char*> q(LOOKUPS);
+    for (size_t i = 0; i < LOOKUPS; i++) q[i] = keys[rng() % keys.size()].c_str();
+
+    Clock::time_point t0 = Clock::now();
+    for (size_t i = 0; i < LOOKUPS; i++) sink += d.search(q[i]).length();
+    Clock::time_point t1 = Clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / LOOKUPS;
+}
+
+int main() {
+    size_t sink = 0;
+#ifdef _DICT_FREEZE_MPH
+    const char* layout = "minimal perfect hash";
+#else
+    const char* layout = "Eytzinger";
+#endif
+    printf("frozen layout: %s, %zu lookups per row\n", layout, LOOKUPS);
+    printf("%8s %12s %12s %12s %12s %12s\n", "keys", "live ns", "frozen ns", "live bytes", "frozen bytes", "freeze us");
+
+    const size_t sizes[] = { 100, 500, 1000, 2000, 5000 };
+    for (size_t n : sizes) {
+        std::vector<std::string> keys;
+        Dictionary d;
+        for (size_t i = 0; i < n; i++) {
+            keys.push_back("cfg.section" + std::to_string(i % 37) + ".key" + std::to_string(i));
+            d.insert(keys.back().c_str(), std::to_string(i).c_str());
+        }
+
+        double live = nsPerLookup(d, keys, sink);
+        size_t liveBytes = d.size();
+
+        Clock::time_point t0 = Clock::now();
+        if (d.freeze() != DICTIONARY_OK) {
+            printf("freeze failed at %zu keys\n", n);
+            return 1;
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+
+        double frozen = nsPerLookup(d, keys, sink);
+        printf("%8zu %12.1f %12.1f %12zu %12zu %12.0f\n", n, live, frozen, liveBytes, d.size(), us);
+    }
+    return sink == 0;   // keep the lookups observable
+}
@@ -0,0 +1,94 @@
+// bench-dictionary-layout.cpp - host benchmark: the 1000-key workload of the
+// README's ESP32 benchmark (examples/Dict_Example02_ESP32_PSRAM) with the default
+// node layout and with _DICT_PACK_STRUCTURES. Keys are two random words joined
+// by '-', values four words; the sketch's lookups join two words without the '-'
+// and so nearly all miss, and are timed here next to lookups of keys that are
+// present. The 1000 words are generated (3 to 10 letters) rather than copied from
+// the sketch. Heap use is glibc's count of bytes in allocated chunks (mallinfo2)
+// for the dictionary and its 1000 pairs. Built twice: bench_layout and
+// bench_layout_packed. Not part of ctest; run by hand:
+//
+//   ./build/bench_layout && ./build/bench_layout_packed
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <chrono>
+#include <cstdio>
+#include <malloc.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t KEYS = 1000;
+static const size_t LOOKUPS = 1000000;
+static const size_t ROUNDS = 200;      // populate / delete cycles timed for removes
+
+int main() {
+    std::mt19937 rng(42);
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 1000; i++) {
+        std::string w;
+        for (size_t n = 3 + rng() % 8; n; n--) w += (char)('a' + rng() % 26);
+        words.push_back(w);
+    }
+    auto word = [&]() -> const std::string& { return words[rng() % words.size()]; };
+
+    std::vector<std::string> keys, vals;
+    while (keys.size() < KEYS) {
+        std::string k = word() + "-" + word();
+        bool dup = false;
+        for (const std::string& o : keys) dup = dup || o == k;
+        if (dup) continue;
+        keys.push_back(k);
+        vals.push_back(word() + " " + word() + " " + word() + " " + word());
+    }
+    std::vector<const char*> hits(LOOKUPS), misses(LOOKUPS);
+    std::vector<std::string> missKeys;
+    for (size_t i = 0; i < 1000; i++) missKeys.push_back(word() + word());
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        hits[i] = keys[rng() % KEYS].c_str();
+        misses[i] = missKeys[rng() % missKeys.size()].c_str();
+    }
+
+#ifdef _DICT_PACK_STRUCTURES
+    printf("packed structures, sizeof(node) = %zu\n", sizeof(node));
+#else
+    printf("natural layout, sizeof(node) = %zu\n", sizeof(node));
+#endif
+
+    size_t heap0 = mallinfo2().uordblks;
+    Dictionary* d = new Dictionary(10);
+    for (size_t i = 0; i < KEYS; i++) d->insert(keys[i].c_str(), vals[i].c_str());
+    size_t bytes = mallinfo2().uordblks - heap0;
+
+    size_t sink = 0;
+    Clock::time_point t0 = Clock::now();
+    for (size_t i = 0; i < LOOKUPS; i++) sink += d->search(hits[i]).length();
+    Clock::time_point t1 = Clock::now();
+    for (size_t i = 0; i < LOOKUPS; i++) sink += d->search(misses[i]).length();
+    Clock::time_point t2 = Clock::now();
+    delete d;
+
+    // Removes as in the sketch: last key first, by its position.
+    double removeNs = 0;
+    for (size_t r = 0; r < ROUNDS; r++) {
+        d = new Dictionary(10);
+        for (size_t i = 0; i < KEYS; i++) d->insert(keys[i].c_str(), vals[i].c_str());
+        Clock::time_point t3 = Clock::now();
+        for (size_t l = d->count(); l > 0; l--) {
+            String k = d->key(l - 1);
+            d->remove(k);
+        }
+        removeNs += std::chrono::duration<double, std::nano>(Clock::now() - t3).count();
+        delete d;
+    }
+
+    printf("%12s %14s %14s %14s\n", "heap bytes", "hit ns", "miss ns", "remove ns");
+    printf("%12zu %14.1f %14.1f %14.1f\n", bytes,
+           std::chrono::duration<double, std::nano>(t1 - t0).count() / LOOKUPS,
+           std::chrono::duration<double, std::nano>(t2 - t1).count() / LOOKUPS,
+           removeNs / (ROUNDS * KEYS));
+    return sink == 0;   // keep the lookups observable
+}
@@ -0,0 +1,115 @@
+// bench-dictionary-levels.cpp - host benchmark: search() on the default tree, in
+// ns per lookup and per tree level visited, for dictionaries from 1,000 to
+// 1,000,000 keys with distinct first bytes. The levels are counted on a shadow
+// tree built here with the same insertion order and key order (prefix "crc",
+// length, bytes), since the dictionary does not expose its shape. Built four
+// times: bench_levels (prefix "crc", the tree default), bench_levels_fnv
+// (_DICT_HASH_FNV1A), bench_levels_arena (_DICT_ARENA) and bench_levels_ref32
+// (_DICT_ARENA_OFFSETS=32: 32-bit links). Not part of ctest; run by hand:
+//
+//   ./build/bench_levels && ./build/bench_levels_fnv
+//   ./build/bench_levels_arena && ./build/bench_levels_ref32
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t LOOKUPS = 1000000;
+
+// Dictionary::crc() of a key, for the two builds (32-bit, as by default).
+static uintNN_t keyCrc(const std::string& s) {
+#ifdef _DICT_HASH_FNV1A
+    uint32_t h = 2166136261UL;
+    for (unsigned char c : s) { h ^= c; h *= 16777619UL; }
+    return h;
+#else
+    uintNN_t a = 0;
+    memcpy(&a, s.data(), std::min(s.size(), sizeof(a)));
+    return a;
+#endif
+}
+
+// The plain tree's order: crc(), then length, then the key bytes.
+struct Shadow {
+    struct Item { uintNN_t k; const std::string* s; int32_t left, right; };
+    std::vector<Item> items;
+
+    static int compare(uintNN_t k, const std::string& s, const Item& n) {
+        if (k != n.k) return k < n.k ? -1 : 1;
+        if (s.size() != n.s->size()) return s.size() < n.s->size() ? -1 : 1;
+        return memcmp(s.data(), n.s->data(), s.size());
+    }
+    void insert(const std::string& s) {
+        uintNN_t k = keyCrc(s);
+        items.push_back(Item{ k, &s, -1, -1 });
+        if (items.size() == 1) return;
+        int32_t i = 0;
+        for (;;) {
+            int32_t& next = compare(k, s, items[i]) < 0 ? items[i].left : items[i].right;
+            if (next < 0) { next = (int32_t)items.size() - 1; return; }
+            i = next;
+        }
+    }
+    size_t levels(const std::string& s) const {
+        uintNN_t k = keyCrc(s);
+        size_t d = 1;
+        for (int32_t i = 0; int c = compare(k, s, items[i]); d++) i = c < 0 ? items[i].left : items[i].right;
+        return d;
+    }
+};
+
+int main() {
+#ifdef _DICT_HASH_KEYS
+    const char* mode = "full-key hash";
+#else
+    const char* mode = "key prefix";
+#endif
+    printf("tree ordered by %s, node %zu bytes, %zu lookups per row\n", mode, sizeof(node), LOOKUPS);
+    printf("%8s %8s %12s %12s\n", "keys", "levels", "ns/lookup", "ns/level");
+
+    size_t sink = 0;
+    const size_t sizes[] = { 1000, 10000, 100000, 1000000 };
+    for (size_t n : sizes) {
+        // Distinct first bytes, inserted in random order.
+        std::vector<std::string> keys;
+        std::mt19937 rng(42);
+        for (size_t i = 0; i < n; i++) {
+            char b[32];
+            snprintf(b, sizeof(b), "%08x.%zu", (unsigned)rng(), i);
+            keys.push_back(b);
+        }
+
+        Dictionary* d = new Dictionary(n);
+        Shadow shadow;
+        for (const std::string& k : keys) {
+            d->insert(k.c_str(), "value");
+            shadow.insert(k);
+        }
+
+        std::vector<const char*> q(LOOKUPS);
+        double levels = 0;
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            const std::string& k = keys[rng() % n];
+            q[i] = k.c_str();
+            levels += shadow.levels(k);
+        }
+        levels /= LOOKUPS;
+
+        Clock::time_point t0 = Clock::now();
+        for (size_t i = 0; i < LOOKUPS; i++) sink += d->search(q[i]).length();
+        Clock::time_point t1 = Clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / LOOKUPS;
+
+        printf("%8zu %8.1f %12.1f %12.2f\n", n, levels, ns, ns / levels);
+        delete d;
+    }
+    return sink == 0;   // keep the lookups observable
+}
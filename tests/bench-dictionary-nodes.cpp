@@ -0,0 +1,82 @@
+// bench-dictionary-nodes.cpp - host benchmark: heap bytes per entry and insert /
+// lookup times with three allocations per node (default), one
+// (_DICT_SINGLE_ALLOC), and short strings stored in the node (_DICT_SSO). Built
+// three times: bench_nodes, bench_nodes_single and bench_nodes_sso. Heap use is
+// glibc's own count of bytes in allocated chunks (mallinfo2), so it includes the
+// allocator's per-block headers and rounding. Two key shapes: config-style keys
+// and values (~20 and ~11 bytes), and short ones (keys up to 6 bytes, values like
+// "1", "true" or a port number). Not part of ctest; run by hand:
+//
+//   ./build/bench_nodes && ./build/bench_nodes_single && ./build/bench_nodes_sso
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <chrono>
+#include <cstdio>
+#include <malloc.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t LOOKUPS = 1000000;
+
+static size_t heapInUse() {
+    return mallinfo2().uordblks;
+}
+
+int main() {
+    size_t sink = 0;
+#if defined(_DICT_SINGLE_ALLOC)
+    printf("nodes: one block per entry (_DICT_SINGLE_ALLOC), sizeof(node) = %zu\n", sizeof(node));
+#elif defined(_DICT_SSO)
+    printf("nodes: strings of up to %d bytes inline (_DICT_SSO), sizeof(node) = %zu\n", _DICT_SSO_LEN, sizeof(node));
+#else
+    printf("nodes: node + key + value blocks, sizeof(node) = %zu\n", sizeof(node));
+#endif
+    printf("%8s %8s %12s %12s %12s %14s\n", "shape", "keys", "bytes/entry", "insert ns", "lookup ns", "grow-value ns");
+
+    const size_t sizes[] = { 100, 1000, 10000 };
+    for (int shortKeys = 0; shortKeys < 2; shortKeys++)
+    for (size_t n : sizes) {
+        std::vector<std::string> keys, vals;
+        for (size_t i = 0; i < n; i++) {
+            std::string h = std::to_string(i * 7919 % 100003);
+            if (shortKeys) {
+                keys.push_back("p" + h);
+                vals.push_back(i % 3 == 0 ? "1" : i % 3 == 1 ? "true" : std::to_string(1024 + i % 60000));
+            }
+            else {
+                keys.push_back(h + ".section" + std::to_string(i % 37) + ".key");
+                vals.push_back("value-" + h);
+            }
+        }
+
+        size_t heap0 = heapInUse();
+        Dictionary* d = new Dictionary(n);   // n only sets the segment width (8 to 256 slots)
+        Clock::time_point t0 = Clock::now();
+        for (size_t i = 0; i < n; i++) d->insert(keys[i].c_str(), vals[i].c_str());
+        Clock::time_point t1 = Clock::now();
+        double perEntry = (double)(heapInUse() - heap0) / n;
+        double insertNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+
+        std::mt19937 rng(42);
+        std::vector<const char*> q(LOOKUPS);
+        for (size_t i = 0; i < LOOKUPS; i++) q[i] = keys[rng() % n].c_str();
+        t0 = Clock::now();
+        for (size_t i = 0; i < LOOKUPS; i++) sink += d->search(q[i]).length();
+        t1 = Clock::now();
+        double lookupNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / LOOKUPS;
+
+        // Values twice as long: every entry outgrows its buffer (or its block).
+        t0 = Clock::now();
+        for (size_t i = 0; i < n; i++) d->insert(keys[i].c_str(), (vals[i] + vals[i]).c_str());
+        t1 = Clock::now();
+        double growNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+
+        printf("%8s %8zu %12.1f %12.1f %12.1f %14.1f\n", shortKeys ? "short" : "config", n, perEntry, insertNs, lookupNs, growNs);
+        delete d;
+    }
+    return sink == 0;   // keep the lookups observable
+}
@@ -0,0 +1,58 @@
+// bench-dictionary-reload.cpp - host benchmark: a configuration reloaded over and
+// over (destroy() + jload()) with nodes from the heap (default) and from the
+// dictionary's arena (_DICT_ARENA). Built twice: bench_reload and bench_reload_arena.
+// Heap use is glibc's count of bytes in allocated chunks (mallinfo2) after the
+// first load. Not part of ctest; run by hand:
+//
+//   ./build/bench_reload && ./build/bench_reload_arena
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <chrono>
+#include <cstdio>
+#include <malloc.h>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+static const int RELOADS = 50;
+
+int main() {
+#ifdef _DICT_ARENA
+    printf("nodes: arena, %d-byte chunks (_DICT_ARENA)\n", _DICT_ARENA_CHUNK);
+#else
+    printf("nodes: one heap block per node, key and value\n");
+#endif
+    printf("%8s %12s %12s %12s\n", "keys", "bytes/entry", "destroy ns", "jload ns");
+
+    const size_t sizes[] = { 100, 1000, 10000 };
+    for (size_t n : sizes) {
+        std::string js = "{";
+        for (size_t i = 0; i < n; i++) {
+            std::string h = std::to_string(i * 7919 % 100003);
+            js += std::string(i ? "," : "") + "\"" + h + ".section" + std::to_string(i % 37) + ".key\":\"value-" + h + "\"";
+        }
+        js += "}";
+        String json(js.c_str());
+
+        size_t heap0 = mallinfo2().uordblks;
+        Dictionary* d = new Dictionary(n);
+        d->jload(json);
+        double perEntry = (double)(mallinfo2().uordblks - heap0) / n;
+
+        double destroyNs = 0, loadNs = 0;
+        for (int r = 0; r < RELOADS; r++) {
+            Clock::time_point t0 = Clock::now();
+            d->destroy();
+            Clock::time_point t1 = Clock::now();
+            d->jload(json);
+            Clock::time_point t2 = Clock::now();
+            destroyNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+            loadNs += std::chrono::duration<double, std::nano>(t2 - t1).count();
+        }
+
+        printf("%8zu %12.1f %12.1f %12.1f\n", n, perEntry, destroyNs / RELOADS / n, loadNs / RELOADS / n);
+        delete d;
+    }
+    return 0;
+}
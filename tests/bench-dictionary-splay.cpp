@@ -0,0 +1,87 @@
+// bench-dictionary-splay.cpp - host benchmark: search() on the plain tree vs. the
+// splay tree (_DICT_SPLAY) under skewed (Zipf) and uniform access. Built twice:
+// bench_splay_tree (default tree) and bench_splay (_DICT_SPLAY). Not part of
+// ctest; run by hand:
+//
+//   ./build/bench_splay_tree && ./build/bench_splay
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const size_t LOOKUPS = 1000000;
+
+// Lookup sequence where the key of popularity rank r (1-based) is drawn with
+// probability proportional to 1 / r^s; s = 0 is uniform. Ranks are assigned to
+// keys at random, so the hot keys are not the first ones inserted.
+static std::vector<const char*> zipf(const std::vector<std::string>& keys, double s, double& top5) {
+    std::mt19937 rng(42);
+    size_t n = keys.size();
+
+    std::vector<size_t> rank(n);
+    for (size_t i = 0; i < n; i++) rank[i] = i;
+    std::shuffle(rank.begin(), rank.end(), rng);
+
+    std::vector<double> cdf(n);
+    double sum = 0;
+    for (size_t r = 0; r < n; r++) {
+        sum += 1.0 / std::pow((double)(r + 1), s);
+        cdf[r] = sum;
+    }
+    top5 = cdf[std::min<size_t>(5, n) - 1] / sum;
+
+    std::uniform_real_distribution<double> u(0, sum);
+    std::vector<const char*> q(LOOKUPS);
+    for (size_t i = 0; i < LOOKUPS; i++) {
+        size_t r = std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+        q[i] = keys[rank[std::min(r, n - 1)]].c_str();
+    }
+    return q;
+}
+
+static double nsPerLookup(Dictionary& d, const std::vector<const char*>& q, size_t& sink) {
+    Clock::time_point t0 = Clock::now();
+    for (size_t i = 0; i < q.size(); i++) sink += d.search(q[i]).length();
+    Clock::time_point t1 = Clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / q.size();
+}
+
+int main() {
+    size_t sink = 0;
+#ifdef _DICT_SPLAY
+    const char* mode = "splay tree (_DICT_SPLAY)";
+#else
+    const char* mode = "plain tree";
+#endif
+    printf("index: %s, %zu lookups per row\n", mode, LOOKUPS);
+    printf("%8s %8s %10s %12s\n", "keys", "zipf s", "top-5 hits", "ns/lookup");
+
+    const size_t sizes[] = { 100, 500, 2000 };
+    const double skews[] = { 0.0, 0.8, 1.0, 1.2 };
+    for (size_t n : sizes) {
+        // Insert in a random order so the plain tree is not degenerate.
+        std::vector<std::string> keys;
+        for (size_t i = 0; i < n; i++) keys.push_back("cfg.section" + std::to_string(i % 37) + ".key" + std::to_string(i));
+        std::vector<std::string> order(keys);
+        std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+        Dictionary d;
+        for (const std::string& k : order) d.insert(k.c_str(), "v");
+
+        for (double s : skews) {
+            double top5;
+            std::vector<const char*> q = zipf(keys, s, top5);
+            double ns = nsPerLookup(d, q, sink);
+            printf("%8zu %8.1f %9.0f%% %12.1f\n", n, s, top5 * 100, ns);
+        }
+    }
+    return sink == 0;   // keep the lookups observable
+}
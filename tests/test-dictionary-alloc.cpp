@@ -0,0 +1,228 @@
+// test-dictionary-alloc.cpp - allocation policy (Dictionary::setAllocator).
+//
+// Two instrumented heaps stand in for an ESP32's internal RAM and PSRAM: the
+// policy under test puts value buffers in "psram" and everything a lookup walks
+// (nodes, keys, the positional array and the index) in "dram". Every block is
+// recorded with the region it was allocated for, so the tests can assert where
+// each structure lives, that every free names the heap and region the block came
+// from, and that nothing is left behind.
+#include <gtest/gtest.h>
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <map>
+#include <set>
+#include <string>
+
+namespace {
+
+struct Heap {
+    std::map<void*, uint8_t> live;     // block -> region it was allocated for
+    long  allocs = 0;
+    bool  fail = false;                 // every allocation fails while set
+
+    size_t count(uint8_t region) const {
+        size_t c = 0;
+        for (const auto& b : live) c += (b.second == region);
+        return c;
+    }
+};
+
+Heap  g_dram, g_psram;
+long  g_badFrees = 0;                   // frees with the wrong heap or region
+size_t g_largestIndex = 0;              // largest DICT_MEM_INDEX block requested
+
+Heap& heapOf(uint8_t region) { return region == DICT_MEM_VALUE ? g_psram : g_dram; }
+
+void* twoHeapAlloc(size_t size, uint8_t region) {
+    Heap& h = heapOf(region);
+    if (h.fail) return NULL;
+    if (region == DICT_MEM_INDEX && size > g_largestIndex) g_largestIndex = size;
+    void* p = malloc(size);
+    if (p) { h.live[p] = region; h.allocs++; }
+    return p;
+}
+
+void twoHeapFree(void* p, uint8_t region) {
+    Heap& h = heapOf(region);
+    auto it = h.live.find(p);
+    if (it == h.live.end() || it->second != region) g_badFrees++;
+    else h.live.erase(it);
+    free(p);
+}
+
+const DictionaryAllocator twoHeaps = { twoHeapAlloc, twoHeapFree };
+
+std::string key(int i) { return "sensor/" + std::to_string(i) + "/reading"; }
+std::string val(int i) { return "value number " + std::to_string(i) + " of the telemetry table"; }
+
+}  // namespace
+
+class DictionaryAlloc : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        g_dram = Heap();
+        g_psram = Heap();
+        g_badFrees = 0;
+        g_largestIndex = 0;
+        Dictionary::setAllocator(&twoHeaps);
+    }
+    void TearDown() override {
+        Dictionary::setAllocator(NULL);
+    }
+};
+
+// Values land in psram, one buffer each; nodes, keys and the index stay in dram.
+TEST_F(DictionaryAlloc, ValuesGoToTheirOwnHeap) {
+    const int N = 300;
+    {
+        Dictionary d;
+        for (int i = 0; i < N; i++) ASSERT_EQ(d.insert(key(i).c_str(), val(i).c_str()), DICTIONARY_OK);
+
+        EXPECT_EQ(g_psram.live.size(), (size_t)N);
+        EXPECT_EQ(g_psram.count(DICT_MEM_VALUE), (size_t)N);
+        EXPECT_EQ(g_dram.count(DICT_MEM_VALUE), 0u);
+        EXPECT_EQ(g_dram.count(DICT_MEM_NODE), (size_t)N);
+        EXPECT_EQ(g_dram.count(DICT_MEM_KEY), (size_t)N);
+        EXPECT_GT(g_dram.count(DICT_MEM_INDEX), 0u);
+
+        for (int i = 0; i < N; i++) EXPECT_STREQ(d.search(key(i).c_str()).c_str(), val(i).c_str());
+    }
+    EXPECT_TRUE(g_dram.live.empty());
+    EXPECT_TRUE(g_psram.live.empty());
+    EXPECT_EQ(g_badFrees, 0);
+}
+
+// Updates, removes and destroy() free every block through the heap it came from.
+TEST_F(DictionaryAlloc, ChurnKeepsTheHeapsBalanced) {
+    const int N = 200;
+    {
+        Dictionary d;
+        for (int i = 0; i < N; i++) ASSERT_EQ(d.insert(key(i).c_str(), val(i).c_str()), DICTIONARY_OK);
+        for (int i = 0; i < N; i += 3) ASSERT_EQ(d.insert(key(i).c_str(), (val(i) + "+" + val(i)).c_str()), DICTIONARY_OK);
+        for (int i = 0; i < N; i += 2) ASSERT_EQ(d.remove(key(i).c_str()), DICTIONARY_OK);
+
+        EXPECT_EQ(g_psram.live.size(), d.count());
+        EXPECT_EQ(g_dram.count(DICT_MEM_NODE), d.count());
+        for (int i = 1; i < N; i += 2) {
+            std::string v = i % 3 ? val(i) : val(i) + "+" + val(i);
+            EXPECT_STREQ(d.search(key(i).c_str()).c_str(), v.c_str());
+        }
+
+        d.destroy();
+        EXPECT_TRUE(g_psram.live.empty());
+        EXPECT_EQ(g_dram.count(DICT_MEM_NODE), 0u);
+
+        ASSERT_EQ(d.insert("again", "and again and again"), DICTIONARY_OK);
+#ifdef _DICT_FLAT
+        EXPECT_TRUE(g_psram.live.empty());     // flat again: the value is in the block
+#else
+        EXPECT_EQ(g_psram.live.size(), 1u);
+#endif
+    }
+    EXPECT_TRUE(g_dram.live.empty());
+    EXPECT_TRUE(g_psram.live.empty());
+    EXPECT_EQ(g_badFrees, 0);
+}
+
+#if defined(_DICT_ENGINE_TREE) && !defined(_DICT_BLOOM) && !defined(_DICT_ORDERED)
+// The positional array grows a segment at a time, so no index block is anywhere
+// near the size of the whole array, and removes hand the segments back.
+TEST_F(DictionaryAlloc, PositionalArrayGrowsBySegments) {
+    const int N = 2000;
+    {
+        Dictionary d(16);
+        for (int i = 0; i < N; i++) ASSERT_EQ(d.insert(key(i).c_str(), val(i).c_str()), DICTIONARY_OK);
+        EXPECT_LT(g_largestIndex, N * sizeof(node*) / 8);
+        EXPECT_GT(g_dram.count(DICT_MEM_INDEX), (size_t)N / 16);
+
+        for (int i = 0; i < N - 10; i++) ASSERT_EQ(d.remove(key(i).c_str()), DICTIONARY_OK);
+        EXPECT_LE(g_dram.count(DICT_MEM_INDEX), 3u);     // directory, segment in use, spare
+        std::set<std::string> left;
+        for (int i = 0; i < 10; i++) {
+            left.insert(d.key(i).c_str());
+            EXPECT_STREQ(d.value(i).c_str(), d.search(d.key(i)).c_str());
+        }
+        for (int i = N - 10; i < N; i++) EXPECT_EQ(left.count(key(i)), 1u);
+    }
+    EXPECT_TRUE(g_dram.live.empty());
+    EXPECT_EQ(g_badFrees, 0);
+}
+#endif
+
+#ifdef _DICT_FLAT
+// A flat dictionary is a single block: no nodes, no key or value buffers and no
+// positional array. Outgrowing _DICT_FLAT_MAX moves the pairs into nodes, in the
+// same order, and frees the block.
+TEST_F(DictionaryAlloc, FlatDictionaryIsOneBlock) {
+    const int N = _DICT_FLAT_MAX;
+    {
+        Dictionary d;
+        for (int i = 0; i < N; i++) ASSERT_EQ(d.insert(key(i).c_str(), val(i).c_str()), DICTIONARY_OK);
+        ASSERT_EQ(d.insert(key(0).c_str(), "a new value for the first key"), DICTIONARY_OK);
+#ifndef _DICT_BLOOM
+        EXPECT_EQ(g_dram.live.size(), 1u);
+#endif
+        EXPECT_EQ(g_dram.count(DICT_MEM_NODE), 0u);
+        EXPECT_EQ(g_dram.count(DICT_MEM_KEY), 0u);
+        EXPECT_TRUE(g_psram.live.empty());
+        EXPECT_STREQ(d.search(key(0).c_str()).c_str(), "a new value for the first key");
+        for (int i = 1; i < N; i++) EXPECT_STREQ(d.search(key(i).c_str()).c_str(), val(i).c_str());
+
+        ASSERT_EQ(d.insert(key(N).c_str(), val(N).c_str()), DICTIONARY_OK);
+        EXPECT_EQ(g_dram.count(DICT_MEM_NODE), (size_t)N + 1);
+        EXPECT_EQ(g_psram.live.size(), (size_t)N + 1);
+        for (int i = 1; i <= N; i++) {
+            EXPECT_STREQ(d.key(i).c_str(), key(i).c_str());
+            EXPECT_STREQ(d.search(key(i).c_str()).c_str(), val(i).c_str());
+        }
+    }
+    EXPECT_TRUE(g_dram.live.empty());
+    EXPECT_TRUE(g_psram.live.empty());
+    EXPECT_EQ(g_badFrees, 0);
+}
+#endif
+
+// An exhausted psram fails the insert or update cleanly; the dictionary and its
+// dram structures are left as they were.
+TEST_F(DictionaryAlloc, FullPsramLeavesDictionaryIntact) {
+    {
+        Dictionary d;
+        for (int i = 0; i < 50; i++) ASSERT_EQ(d.insert(key(i).c_str(), val(i).c_str()), DICTIONARY_OK);
+        size_t dram = g_dram.live.size();
+
+        g_psram.fail = true;
+        EXPECT_EQ(d.insert("brand/new/key", "brand new value"), DICTIONARY_MEM);
+        EXPECT_EQ(d.insert(key(7).c_str(), "a different, longer value for key seven"), DICTIONARY_MEM);
+        g_psram.fail = false;
+
+        EXPECT_EQ(d.count(), 50u);
+        EXPECT_EQ(g_dram.live.size(), dram);
+        EXPECT_EQ(g_psram.live.size(), 50u);
+        for (int i = 0; i < 50; i++) EXPECT_STREQ(d.search(key(i).c_str()).c_str(), val(i).c_str());
+        EXPECT_STREQ(d.search("brand/new/key").c_str(), "");
+    }
+    EXPECT_TRUE(g_dram.live.empty());
+    EXPECT_TRUE(g_psram.live.empty());
+    EXPECT_EQ(g_badFrees, 0);
+}
+
+// freeze() packs the values into its index block and frees their buffers.
+TEST_F(DictionaryAlloc, FreezeMovesValuesIntoTheIndex) {
+    {
+        Dictionary d;
+        for (int i = 0; i < 100; i++) ASSERT_EQ(d.insert(key(i).c_str(), val(i).c_str()), DICTIONARY_OK);
+        ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+
+        EXPECT_TRUE(g_psram.live.empty());
+        EXPECT_EQ(g_dram.count(DICT_MEM_NODE), 0u);
+        for (int i = 0; i < 100; i++) EXPECT_STREQ(d.search(key(i).c_str()).c_str(), val(i).c_str());
+    }
+    EXPECT_TRUE(g_dram.live.empty());
+    EXPECT_EQ(g_badFrees, 0);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -191,6 +191,32 @@ TEST_F(DictionaryBasic, ManySequentialInsertsAndLookups) {
     }
 }
 
+// Published check values of the full-key hash policies. The CRC-32C build is
+// compiled once with the nibble table and, on x86, once with -msse4.2: both
+// must give the same answers. The lengths cover the 8-, 4- and 1-byte steps of
+// the crc32 instruction path.
+#if defined(_DICT_HASH_CRC32C) && _DICT_CRC == 32
+TEST_F(DictionaryBasic, Crc32cKnownAnswers) {
+    const char zeros[32] = { 0 };
+    char ramp[32];
+    for (int i = 0; i < 32; i++) ramp[i] = (char)i;
+    EXPECT_EQ(Dictionary::crc("", 0), 0x00000000u);
+    EXPECT_EQ(Dictionary::crc("123456789", 9), 0xE3069283u);
+    EXPECT_EQ(Dictionary::crc("123456789012", 12), 0xD75DFDFBu);
+    EXPECT_EQ(Dictionary::crc(zeros, 32), 0x8A9136AAu);
+    EXPECT_EQ(Dictionary::crc(ramp, 32), 0x46DD794Eu);
+    EXPECT_EQ(Dictionary::crc("The quick brown fox jumps over the lazy dog", 43), 0x22620404u);
+}
+#endif
+
+#if defined(_DICT_HASH_FNV1A) && _DICT_CRC == 32
+TEST_F(DictionaryBasic, Fnv1aKnownAnswers) {
+    EXPECT_EQ(Dictionary::crc("", 0), 0x811C9DC5u);
+    EXPECT_EQ(Dictionary::crc("a", 1), 0xE40C292Cu);
+    EXPECT_EQ(Dictionary::crc("foobar", 6), 0xBF9CF968u);
+}
+#endif
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
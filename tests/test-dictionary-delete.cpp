@@ -5,6 +5,9 @@
 #include "Arduino.h"
 #include "Dictionary.h"
 
+#include <cmath>
+#include <cstdio>
+#include <map>
 #include <string>
 #include <set>
 
@@ -76,6 +79,47 @@ TEST_F(DictionaryDelete, RemoveHalfKeepsTheRest) {
     }
 }
 
+#ifndef _DICT_ORDERED
+// remove() moves the last pair into the removed pair's index and leaves the
+// others where they are, whatever the removed key's place in the index (a tree
+// node with two children is replaced by its successor node, not its contents).
+TEST_F(DictionaryDelete, RemoveMovesTheLastPairIntoItsIndex) {
+    Dictionary d;
+    d("a", "va"); d("b", "vb"); d("c", "vc"); d("d", "vd"); d("e", "ve");
+    ASSERT_EQ(d.remove("a"), DICTIONARY_OK);
+    ASSERT_EQ(d.count(), 4u);
+    const char* order[] = { "e", "b", "c", "d" };
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_STREQ(d(i).c_str(), order[i]) << i;
+        EXPECT_STREQ(d[i].c_str(), (std::string("v") + order[i]).c_str()) << i;
+    }
+    for (const char* k : { "b", "e", "c" }) {
+        ASSERT_EQ(d.remove(k), DICTIONARY_OK);
+        ASSERT_EQ(d.count(), 3u);
+        d(k, (std::string("v") + k).c_str());   // goes back in last
+    }
+    const char* after[] = { "b", "d", "e", "c" };
+    ASSERT_EQ(d.count(), 4u);
+    for (size_t i = 0; i < 4; i++) EXPECT_STREQ(d(i).c_str(), after[i]) << i;
+}
+#endif
+
+#if _DICT_MAX_PAIRS <= UINT16_MAX && !defined(_DICT_ARENA_OFFSETS)
+// With a 16-bit position in the node, the dictionary is full at _DICT_MAX_PAIRS.
+TEST_F(DictionaryDelete, FullAtMaxPairs) {
+    Dictionary d(256);
+    for (size_t i = 0; i < _DICT_MAX_PAIRS; i++)
+        ASSERT_EQ(d.insert(("k" + std::to_string(i)).c_str(), "v"), DICTIONARY_OK) << i;
+    EXPECT_EQ(d.insert("one more", "v"), DICTIONARY_MEM);
+    EXPECT_EQ(d.count(), (size_t)_DICT_MAX_PAIRS);
+    EXPECT_STREQ(d["one more"].c_str(), "");
+
+    ASSERT_EQ(d.remove("k0"), DICTIONARY_OK);
+    ASSERT_EQ(d.insert("one more", "v"), DICTIONARY_OK);
+    EXPECT_STREQ(d(_DICT_MAX_PAIRS - 1).c_str(), "one more");
+}
+#endif
+
 TEST_F(DictionaryDelete, DestroyEmptiesAndObjectIsReusable) {
     Dictionary d;
     d("a", "1"); d("b", "2");
@@ -117,6 +161,80 @@ TEST_F(DictionaryDelete, InterleavedChurnRemainsConsistent) {
                      std::to_string(v).c_str());
 }
 
+#ifdef _DICT_BALANCED
+// Keys in sorted order turn a plain tree into a list; the AVL tree must stay
+// within its height bound, ~1.44 log2(n), through the inserts and through
+// removes from one end.
+TEST_F(DictionaryDelete, SortedKeysKeepTheTreeShallow) {
+    const int N = 5000;
+    Dictionary d;
+    char k[16];
+    for (int i = 0; i < N; i++) {
+        snprintf(k, sizeof(k), "key%05d", i);
+        ASSERT_EQ(d.insert(k, "v"), DICTIONARY_OK);
+        if ((i & (i + 1)) == 0) {   // at every power of two
+            ASSERT_LE(d.height(), 1.45 * std::log2(i + 3)) << "after " << i + 1 << " inserts";
+        }
+    }
+    EXPECT_GE(d.height(), std::log2(N));
+    EXPECT_LE(d.height(), 1.45 * std::log2(N + 2));
+
+    for (int i = 0; i < N / 2; i++) {
+        snprintf(k, sizeof(k), "key%05d", i);
+        ASSERT_EQ(d.remove(k), DICTIONARY_OK);
+    }
+    EXPECT_EQ(d.count(), (size_t)(N - N / 2));
+    EXPECT_LE(d.height(), 1.45 * std::log2(N - N / 2 + 2));
+    for (int i = N / 2; i < N; i += 97) {
+        snprintf(k, sizeof(k), "key%05d", i);
+        EXPECT_STREQ(d[k].c_str(), "v");
+    }
+}
+#endif
+
+#ifdef _DICT_ENGINE_HASH
+// A resize moves only NODEHASH_MIGRATE old slots per insert/remove, so for a
+// while after each one keys live in both tables. Grow through several resizes
+// with removes mixed in - of keys still in the old table as well as new ones -
+// and after every step check each live key, and that no removed key comes back
+// from the old table.
+TEST_F(DictionaryDelete, IncrementalResizeKeepsEveryKey) {
+    Dictionary d(8);
+    std::map<std::string, std::string> live;
+    std::set<std::string> gone;
+    int next = 0;
+
+    for (int step = 0; step < 1500; step++) {
+        if (step % 4 == 3 && !live.empty()) {
+            // alternate between the oldest live key and the newest one
+            std::string k = step % 8 == 3 ? live.begin()->first : "key" + std::to_string(next - 1);
+            if (!live.count(k)) k = live.begin()->first;
+            ASSERT_EQ(d.remove(k.c_str()), DICTIONARY_OK);
+            live.erase(k);
+            gone.insert(k);
+        }
+        else if (step % 50 == 49 && !gone.empty()) {
+            std::string k = *gone.begin();          // a removed key comes back
+            ASSERT_EQ(d.insert(k.c_str(), "again"), DICTIONARY_OK);
+            live[k] = "again";
+            gone.erase(k);
+        }
+        else {
+            std::string k = "key" + std::to_string(next++);
+            std::string v = "v" + std::to_string(step);
+            ASSERT_EQ(d.insert(k.c_str(), v.c_str()), DICTIONARY_OK);
+            live[k] = v;
+        }
+
+        ASSERT_EQ(d.count(), live.size()) << "step=" << step;
+        for (auto& kv : live)
+            ASSERT_STREQ(d[kv.first.c_str()].c_str(), kv.second.c_str()) << "step=" << step;
+        for (auto& k : gone)
+            ASSERT_FALSE(d(String(k.c_str()))) << k << " came back at step=" << step;
+    }
+}
+#endif
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
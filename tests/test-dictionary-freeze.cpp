@@ -0,0 +1,162 @@
+// test-dictionary-freeze.cpp - freeze(): a dictionary turned into a read-only
+// flat Eytzinger index. Lookups, positional access and JSON must be unchanged,
+// mutations must be refused, and destroy() must make it writable again.
+// Default configuration (also rebuilt under other engines/policies and with the
+// minimal perfect hash layout, _DICT_FREEZE_MPH).
+#include <gtest/gtest.h>
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <string>
+
+class DictionaryFreeze : public ::testing::Test {};
+
+static void fill(Dictionary& d, int n) {
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(d.insert(("key" + std::to_string(i)).c_str(),
+                           ("value" + std::to_string(i)).c_str()), DICTIONARY_OK);
+}
+
+TEST_F(DictionaryFreeze, LookupsUnchangedAfterFreeze) {
+    Dictionary d;
+    fill(d, 500);
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    EXPECT_TRUE(d.frozen());
+    EXPECT_EQ(d.count(), 500u);
+    for (int i = 0; i < 500; i++) {
+        std::string k = "key" + std::to_string(i);
+        EXPECT_STREQ(d[k.c_str()].c_str(), ("value" + std::to_string(i)).c_str());
+        EXPECT_TRUE(d(String(k.c_str())));
+    }
+    EXPECT_STREQ(d["key500"].c_str(), "");
+    EXPECT_STREQ(d["nope"].c_str(), "");
+    EXPECT_FALSE(d(String("key-1")));
+}
+
+// Sizes 1..40 cover every shape of the implicit tree (full, left-heavy, single leaf).
+TEST_F(DictionaryFreeze, EveryTreeShapeFindsAllKeys) {
+    for (int n = 1; n <= 40; n++) {
+        Dictionary d;
+        fill(d, n);
+        ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+        for (int i = 0; i < n; i++)
+            EXPECT_STREQ(d[("key" + std::to_string(i)).c_str()].c_str(),
+                         ("value" + std::to_string(i)).c_str()) << "n=" << n << " i=" << i;
+        EXPECT_STREQ(d["key"].c_str(), "") << "n=" << n;
+        EXPECT_STREQ(d["zzz"].c_str(), "") << "n=" << n;
+    }
+}
+
+TEST_F(DictionaryFreeze, PositionalAccessAndJsonPreserved) {
+    Dictionary d;
+    d("b", "2"); d("a", "1"); d("quote\"d", "back\\slash"); d("c", "");
+    String before = d.json();
+    size_t jsz = d.jsize(), esz = d.esize();
+
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    EXPECT_STREQ(d.json().c_str(), before.c_str());
+    EXPECT_EQ(d.jsize(), jsz);
+    EXPECT_EQ(d.esize(), esz);
+    EXPECT_STREQ(d(0).c_str(), "b");
+    EXPECT_STREQ(d[(size_t)2].c_str(), "back\\slash");
+    EXPECT_STREQ(d.key(4).c_str(), "");     // out of range
+}
+
+// Keys sharing the first sizeof(uintNN_t) bytes tie on the prefix and are told
+// apart by length and then by content.
+TEST_F(DictionaryFreeze, SharedPrefixKeys) {
+    Dictionary d;
+    const char* keys[] = { "mqtt.broker.host", "mqtt.broker.port", "mqtt", "mqtt.", "mqtt.user", "mqtz" };
+    for (const char* k : keys) d(k, (String("v:") + k).c_str());
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    for (const char* k : keys) EXPECT_STREQ(d[k].c_str(), (String("v:") + k).c_str());
+    EXPECT_STREQ(d["mqtt.broker"].c_str(), "");
+    EXPECT_STREQ(d["mqt"].c_str(), "");
+}
+
+TEST_F(DictionaryFreeze, MutationsAreRefused) {
+    Dictionary d;
+    fill(d, 10);
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    EXPECT_EQ(d.insert("new", "x"), DICTIONARY_ERR);
+    EXPECT_EQ(d.insert("key1", "changed"), DICTIONARY_ERR);
+    EXPECT_EQ(d.remove("key1"), DICTIONARY_ERR);
+    EXPECT_EQ(d.jload("{\"a\":\"b\"}"), DICTIONARY_ERR);
+    EXPECT_EQ(d.count(), 10u);
+    EXPECT_STREQ(d["key1"].c_str(), "value1");
+    EXPECT_EQ(d.freeze(), DICTIONARY_OK);   // already frozen is fine
+}
+
+TEST_F(DictionaryFreeze, DestroyMakesItWritableAgain) {
+    Dictionary d;
+    fill(d, 10);
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    d.destroy();
+    EXPECT_FALSE(d.frozen());
+    EXPECT_EQ(d.count(), 0u);
+    EXPECT_EQ(d.insert("a", "1"), DICTIONARY_OK);
+    EXPECT_STREQ(d["a"].c_str(), "1");
+}
+
+TEST_F(DictionaryFreeze, CopyAndCompareWithFrozen) {
+    Dictionary a, b;
+    fill(a, 50);
+    fill(b, 50);
+    ASSERT_EQ(b.freeze(), DICTIONARY_OK);
+    EXPECT_TRUE(a == b);
+    EXPECT_TRUE(b == a);
+
+    Dictionary c;
+    c = b;                                  // merge from a frozen source
+    EXPECT_FALSE(c.frozen());
+    EXPECT_TRUE(c == a);
+    b = a;                                  // assigning into a frozen one thaws it
+    EXPECT_FALSE(b.frozen());
+    EXPECT_TRUE(b == a);
+}
+
+// freeze(json) loads with jload() semantics (a repeated key updates the value
+// in place) and freezes in the same call.
+TEST_F(DictionaryFreeze, FreezeFromJson) {
+    Dictionary d;
+    ASSERT_EQ(d.freeze("{\"a\":\"1\",\"b\":\"2\",\"a\":\"3\"}"), DICTIONARY_OK);
+    EXPECT_TRUE(d.frozen());
+    EXPECT_EQ(d.count(), 2u);
+    EXPECT_STREQ(d["a"].c_str(), "3");
+    EXPECT_STREQ(d(0).c_str(), "a");
+
+    Dictionary s;
+    std::string buf = "{\"x\":\"10\",\"y\":\"20\"}";
+    ReadBufferStream stream((uint8_t*)buf.data(), buf.size());
+    ASSERT_EQ(s.freeze(stream), DICTIONARY_OK);
+    EXPECT_TRUE(s.frozen());
+    EXPECT_STREQ(s["y"].c_str(), "20");
+
+    Dictionary e;                           // a parse error leaves it writable
+    EXPECT_EQ(e.freeze("{\"a\":\"line1\nline2\"}"), DICTIONARY_QUOTE);
+    EXPECT_FALSE(e.frozen());
+    EXPECT_EQ(d.freeze("{\"c\":\"4\"}"), DICTIONARY_ERR);   // already frozen
+}
+
+TEST_F(DictionaryFreeze, FreezeEmptyDictionary) {
+    Dictionary d;
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    EXPECT_EQ(d.count(), 0u);
+    EXPECT_STREQ(d["a"].c_str(), "");
+    EXPECT_STREQ(d.json().c_str(), "{}");
+}
+
+// The frozen block is one allocation with a few bytes of index per entry,
+// instead of a node and two buffers per entry.
+TEST_F(DictionaryFreeze, SmallerThanNodes) {
+    Dictionary d;
+    fill(d, 200);
+    size_t before = d.size();
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    EXPECT_LT(d.size(), before);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -11,7 +11,10 @@
 #include "Arduino.h"
 #include "Dictionary.h"
 
+#include <algorithm>
+#include <random>
 #include <string>
+#include <vector>
 
 // ---- malloc fault injection -------------------------------------------------
 extern "C" void* __real_malloc(size_t);
@@ -62,8 +65,16 @@ TEST_F(DictionaryOOM, InsertSurvivesFailureAtEveryAllocationPoint) {
 
 // A failed insert into an existing dictionary must not disturb prior entries.
 TEST_F(DictionaryOOM, FailedInsertLeavesExistingEntriesIntact) {
-    Dictionary d;
-    for (int i = 0; i < 20; i++)
+    const size_t initSize = 10;
+#ifdef _DICT_ORDERED
+    const int N = 32;       // the list needs no memory of its own
+#else
+    // Fill two segments of the positional array, so even when the node comes
+    // from an arena chunk the insert has to allocate.
+    const int N = 2 << NodeArray::segmentShift(initSize);
+#endif
+    Dictionary d(initSize);
+    for (int i = 0; i < N; i++)
         ASSERT_EQ(d.insert(("k" + std::to_string(i)).c_str(),
                            ("v" + std::to_string(i)).c_str()), DICTIONARY_OK);
 
@@ -72,34 +83,216 @@ TEST_F(DictionaryOOM, FailedInsertLeavesExistingEntriesIntact) {
     disarm();
 
     EXPECT_LT(rc, 0);
-    EXPECT_EQ(d.count(), 20u);
-    for (int i = 0; i < 20; i++)
+    EXPECT_EQ(d.count(), (size_t)N);
+    for (int i = 0; i < N; i++)
         EXPECT_STREQ(d.search(("k" + std::to_string(i)).c_str()).c_str(),
                      ("v" + std::to_string(i)).c_str());
     EXPECT_STREQ(d.search("brand_new_key").c_str(), "");
 }
 
-// Two-child delete promotes the in-order successor by copying its (longer)
-// value into the victim node - which needs an allocation. If that fails the
-// remove must be atomic: report the error and leave the tree exactly as it was.
-TEST_F(DictionaryOOM, AtomicTwoChildDeleteOnAllocationFailure) {
+// Growing a value needs a bigger buffer (or, with _DICT_SINGLE_ALLOC, a bigger
+// node block; with _DICT_ARENA, new arena bytes). If that fails the entry keeps its
+// old value and stays reachable.
+TEST_F(DictionaryOOM, FailedValueGrowthLeavesEntryIntact) {
+    Dictionary d;
+    for (int i = 0; i < 60; i++)
+        ASSERT_EQ(d.insert(("k" + std::to_string(i)).c_str(), "v"), DICTIONARY_OK);
+
+    arm(1);
+#ifdef _DICT_ARENA
+    // Use up the current chunk, so that k7's new value needs another one: every
+    // filler update takes as many bytes as k7's, and together they span a chunk.
+    for (int i = 8; i < 60; i++)
+        if (d.insert(("k" + std::to_string(i)).c_str(), "a value much longer than the one stored so far") != DICTIONARY_OK) break;
+#endif
+    int8_t rc = d.insert("k7", "a value much longer than the one stored so far");
+    disarm();
+
+    EXPECT_LT(rc, 0);
+    EXPECT_EQ(d.count(), 60u);
+    EXPECT_STREQ(d.search("k7").c_str(), "v");
+    EXPECT_STREQ(d[7].c_str(), "v");
+
+    // And once memory is back, the update goes through.
+    EXPECT_EQ(d.insert("k7", "a value much longer than the one stored so far"), DICTIONARY_OK);
+    EXPECT_STREQ(d.search("k7").c_str(), "a value much longer than the one stored so far");
+    for (int i = 0; i < 60; i++)
+        EXPECT_EQ(d(String(("k" + std::to_string(i)).c_str())), true);
+}
+
+// Two-child delete relinks the in-order successor node into the victim's place
+// instead of copying its (longer) value into the victim - so it needs no buffer,
+// and succeeds with every allocation failing.
+TEST_F(DictionaryOOM, TwoChildDeleteAllocatesNothing) {
     Dictionary d;
     d("b", "x");                                   // root, short value
     d("a", "left");
-    d("c", "a very long successor value here");    // right; promotes into "b"
+    d("c", "a very long successor value here");    // right; takes the place of "b"
 
-    arm(1);   // the first alloc during remove is the successor value buffer
+    arm(1);   // any malloc would fail
     int8_t rc = d.remove("b");
+    long calls = g_calls;
     disarm();
 
-    EXPECT_LT(rc, 0) << "remove should report the allocation failure";
-    // Tree unchanged: all three keys still present with original values.
-    EXPECT_EQ(d.count(), 3u);
+    EXPECT_EQ(rc, DICTIONARY_OK);
+    EXPECT_EQ(calls, 0);
+    EXPECT_EQ(d.count(), 2u);
     EXPECT_STREQ(d["a"].c_str(), "left");
-    EXPECT_STREQ(d["b"].c_str(), "x");
+    EXPECT_STREQ(d["b"].c_str(), "");
     EXPECT_STREQ(d["c"].c_str(), "a very long successor value here");
 }
 
+// remove() never allocates, whatever the shape of the index: take a dictionary
+// of keys inserted in random order (values of mixed lengths) apart in another
+// random order with every malloc failing, checking the survivors half way.
+TEST_F(DictionaryOOM, RemoveNeverAllocates) {
+    const int N = 300;
+    std::mt19937 rng(25);
+    std::vector<int> order(N);
+    for (int i = 0; i < N; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    Dictionary d;
+    for (int i : order)
+        ASSERT_EQ(d.insert(("key" + std::to_string(i)).c_str(), std::string(1 + rng() % 60, 'a' + i % 26).c_str()), DICTIONARY_OK);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    for (int half = 0; half < 2; half++) {
+        arm(1);   // any malloc would fail
+        for (int j = half * N / 2; j < (half + 1) * N / 2; j++)
+            ASSERT_EQ(d.remove(("key" + std::to_string(order[j])).c_str()), DICTIONARY_OK) << "j=" << j;
+        long calls = g_calls;
+        disarm();
+
+        EXPECT_EQ(calls, 0);
+        ASSERT_EQ(d.count(), (size_t)(N - (half + 1) * N / 2));
+        for (int j = 0; j < N; j++) {
+            int i = order[j];
+            bool live = j >= (half + 1) * N / 2;
+            EXPECT_EQ(d(String(("key" + std::to_string(i)).c_str())), live) << "key" << i;
+            if (live) {
+                EXPECT_EQ(d[("key" + std::to_string(i)).c_str()].c_str()[0], 'a' + i % 26);
+            }
+        }
+    }
+}
+
+// freeze() allocates the flat block (and a temporary sort buffer) before it
+// releases anything, so a failure must leave an ordinary, writable dictionary.
+TEST_F(DictionaryOOM, FailedFreezeLeavesDictionaryIntact) {
+    for (long failPoint = 1; failPoint <= 3; ++failPoint) {
+        Dictionary d;
+        for (int i = 0; i < 20; i++)
+            ASSERT_EQ(d.insert(("k" + std::to_string(i)).c_str(),
+                               ("v" + std::to_string(i)).c_str()), DICTIONARY_OK);
+
+        arm(failPoint);
+        int8_t rc = d.freeze();
+        disarm();
+
+        EXPECT_EQ(d.frozen(), rc == DICTIONARY_OK) << "failPoint=" << failPoint;
+        EXPECT_EQ(d.count(), 20u) << "failPoint=" << failPoint;
+        for (int i = 0; i < 20; i++)
+            EXPECT_STREQ(d.search(("k" + std::to_string(i)).c_str()).c_str(),
+                         ("v" + std::to_string(i)).c_str());
+        if (rc != DICTIONARY_OK) {
+            EXPECT_EQ(d.insert("recovery", "ok"), DICTIONARY_OK) << "failPoint=" << failPoint;
+        }
+    }
+}
+
+#ifdef _DICT_ARENA
+// destroy() keeps the arena's chunks, so loading the same pairs again allocates
+// nothing per entry: the only mallocs are the positional array and (with an
+// external engine) the index table.
+TEST_F(DictionaryOOM, ReloadReusesTheArena) {
+    Dictionary d(64);
+    std::string js = "{";
+    for (int i = 0; i < 50; i++)
+        js += std::string(i ? "," : "") + "\"key" + std::to_string(i) + "\":\"value" + std::to_string(i) + "\"";
+    js += "}";
+    String json(js.c_str());
+    ASSERT_EQ(d.jload(json), DICTIONARY_OK);
+    d.insert("key7", "a value much longer than the one stored so far");   // moves out of the block
+
+    for (int round = 0; round < 3; round++) {
+        d.destroy();
+        EXPECT_EQ(d.count(), 0u);
+
+        arm(-1);   // count only
+        int8_t rc = d.jload(json);
+        long calls = g_calls;
+        disarm();
+
+        ASSERT_EQ(rc, DICTIONARY_OK);
+        EXPECT_LE(calls, 2) << "round=" << round;
+        EXPECT_EQ(d.count(), 50u);
+        EXPECT_STREQ(d["key7"].c_str(), "value7");
+        EXPECT_STREQ(d["key49"].c_str(), "value49");
+    }
+}
+#endif
+
+#if defined(_DICT_ARENA_OFFSETS) && _DICT_ARENA_OFFSETS == 16
+// 16-bit handles number a limited set of chunks, shared by every dictionary (the
+// documented global limit). An insert past the last one fails like an
+// out-of-memory one, in any dictionary, and the numbers of a dictionary's chunks
+// are free for others once it is gone.
+TEST_F(DictionaryOOM, HandlesRunOutCleanly) {
+    Dictionary* a = new Dictionary;
+    int8_t rc = DICTIONARY_OK;
+    int n = 0;
+    for (; n < 100000; n++) {
+        rc = a->insert(("key" + std::to_string(n)).c_str(), ("value" + std::to_string(n)).c_str());
+        if (rc != DICTIONARY_OK) break;
+    }
+    ASSERT_EQ(rc, DICTIONARY_MEM);
+    EXPECT_GT(n, 1000);
+    EXPECT_EQ(a->count(), (size_t)n);
+    EXPECT_EQ(a->insert("key0", std::string(200, 'x').c_str()), DICTIONARY_MEM);   // a value that has to move
+    for (int i = 0; i < n; i += 97)
+        EXPECT_STREQ(a->search(("key" + std::to_string(i)).c_str()).c_str(), ("value" + std::to_string(i)).c_str());
+
+    Dictionary b;
+    EXPECT_EQ(b.insert("other", "dictionary"), DICTIONARY_MEM);
+    delete a;
+    EXPECT_EQ(b.insert("other", "dictionary"), DICTIONARY_OK);
+    EXPECT_STREQ(b["other"].c_str(), "dictionary");
+}
+#endif
+
+#ifdef _DICT_SLAB
+// Removed nodes and strings go back to the slab's free lists, so once the
+// dictionary has reached its working size, churn of same-sized entries - removes,
+// inserts and updates within a size class - allocates nothing at all.
+TEST_F(DictionaryOOM, ChurnReusesTheSlab) {
+    Dictionary d;
+    for (int i = 0; i < 40; i++)
+        ASSERT_EQ(d.insert(("key" + std::to_string(i)).c_str(), "value"), DICTIONARY_OK);
+
+    arm(1);   // any malloc would fail
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 40; i += 2)
+            ASSERT_EQ(d.remove(("key" + std::to_string(i)).c_str()), DICTIONARY_OK);
+        for (int i = 0; i < 40; i += 2)
+            ASSERT_EQ(d.insert(("key" + std::to_string(i + 1000)).c_str(), "value"), DICTIONARY_OK) << "round=" << round;
+        for (int i = 1; i < 40; i += 2)
+            ASSERT_EQ(d.insert(("key" + std::to_string(i)).c_str(), round % 2 ? "value" : "other"), DICTIONARY_OK);
+        for (int i = 0; i < 40; i += 2)
+            ASSERT_EQ(d.remove(("key" + std::to_string(i + 1000)).c_str()), DICTIONARY_OK);
+        for (int i = 0; i < 40; i += 2)
+            ASSERT_EQ(d.insert(("key" + std::to_string(i)).c_str(), "value"), DICTIONARY_OK);
+    }
+    long calls = g_calls;
+    disarm();
+
+    EXPECT_EQ(calls, 0);
+    EXPECT_EQ(d.count(), 40u);
+    for (int i = 0; i < 40; i++)
+        EXPECT_TRUE(d(String(("key" + std::to_string(i)).c_str())));
+}
+#endif
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
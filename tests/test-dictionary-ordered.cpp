@@ -0,0 +1,134 @@
+// test-dictionary-ordered.cpp - insertion order (_DICT_ORDERED) and iteration.
+//
+// With _DICT_ORDERED the pairs keep their insertion order across removes: random
+// inserts, updates and removes are checked against a vector of the live keys,
+// through key(i)/value(i), the iterator and json(). Without it, the iterator
+// tests still run and check that it walks the same pairs as key(i)/value(i).
+#include <gtest/gtest.h>
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string key(int i) { return "key" + std::to_string(i); }
+std::string val(int i) { return "v" + std::to_string(i); }
+
+}  // namespace
+
+class DictionaryOrdered : public ::testing::Test {};
+
+// ---- iteration (every configuration) ----------------------------------------
+TEST_F(DictionaryOrdered, IteratorWalksEveryPairByPosition) {
+    Dictionary d;
+    for (int i = 0; i < 50; i++) d.insert(key(i).c_str(), val(i).c_str());
+    for (int i = 0; i < 50; i += 7) d.remove(key(i).c_str());
+
+    size_t n = 0;
+    for (auto& e : d) {
+        EXPECT_EQ(e.index(), n);
+        EXPECT_STREQ(e.key().c_str(), d.key(n).c_str());
+        EXPECT_STREQ(e.value().c_str(), d.value(n).c_str());
+        n++;
+    }
+    EXPECT_EQ(n, d.count());
+}
+
+TEST_F(DictionaryOrdered, IteratorOnEmptyAndFrozenDictionaries) {
+    Dictionary d;
+    for (auto& e : d) FAIL() << e.key().c_str();
+
+    d("a", "1"); d("b", "2"); d("c", "3");
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    std::string seen;
+    for (auto& e : d) seen += std::string(e.key().c_str()) + e.value().c_str();
+    EXPECT_EQ(seen, "a1b2c3");
+}
+
+#ifdef _DICT_ORDERED
+// ---- insertion order ----------------------------------------------------------
+TEST_F(DictionaryOrdered, RemoveKeepsTheOrderOfTheRest) {
+    Dictionary d;
+    d("a", "va"); d("b", "vb"); d("c", "vc"); d("d", "vd"); d("e", "ve");
+    ASSERT_EQ(d.remove("b"), DICTIONARY_OK);     // two children in the AVL tree
+    ASSERT_EQ(d.remove("a"), DICTIONARY_OK);
+    d("b", "again");                              // a new key goes last
+    d("d", "updated");                            // an update keeps its place
+
+    const char* keys[] = { "c", "d", "e", "b" };
+    const char* vals[] = { "vc", "updated", "ve", "again" };
+    ASSERT_EQ(d.count(), 4u);
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_STREQ(d(i).c_str(), keys[i]) << i;
+        EXPECT_STREQ(d[i].c_str(), vals[i]) << i;
+    }
+    EXPECT_STREQ(d.json().c_str(), "{\"c\":\"vc\",\"d\":\"updated\",\"e\":\"ve\",\"b\":\"again\"}");
+}
+
+// Random churn against a vector of the live keys in insertion order. Values grow
+// and shrink, so _DICT_SINGLE_ALLOC moves nodes to new blocks on the way.
+TEST_F(DictionaryOrdered, ChurnMatchesAnOrderedOracle) {
+    std::mt19937 rng(7);
+    Dictionary d;
+    std::vector<int> live;
+    std::vector<std::string> vals(600);
+
+    for (int step = 0; step < 4000; step++) {
+        int k = rng() % 600;
+        auto it = std::find(live.begin(), live.end(), k);
+        if (rng() % 3 == 0) {
+            ASSERT_EQ(d.remove(key(k).c_str()), DICTIONARY_OK);
+            if (it != live.end()) live.erase(it);
+        }
+        else {
+            vals[k] = val(k) + std::string(rng() % 40, '+');
+            ASSERT_EQ(d.insert(key(k).c_str(), vals[k].c_str()), DICTIONARY_OK);
+            if (it == live.end()) live.push_back(k);
+        }
+        if (step % 500 == 0 || step == 3999) {
+            ASSERT_EQ(d.count(), live.size());
+            size_t i = 0;
+            for (auto& e : d) {
+                ASSERT_STREQ(e.key().c_str(), key(live[i]).c_str()) << "step " << step << " pos " << i;
+                ASSERT_STREQ(e.value().c_str(), vals[live[i]].c_str());
+                i++;
+            }
+            // Out-of-order reads, backwards and jumping, give the same pairs.
+            for (size_t j = live.size(); j-- > 0; )
+                ASSERT_STREQ(d.key(j).c_str(), key(live[j]).c_str());
+            for (size_t j = 0; j < live.size(); j += 1 + rng() % 17)
+                ASSERT_STREQ(d.value(j).c_str(), vals[live[j]].c_str());
+        }
+    }
+}
+
+// remove(key(i)) leaves the next pair at position i.
+TEST_F(DictionaryOrdered, RemovingWhileWalkingByPosition) {
+    Dictionary d;
+    for (int i = 0; i < 100; i++) d.insert(key(i).c_str(), val(i).c_str());
+    for (size_t i = 0; i < d.count(); i++) {
+        if (d.key(i) == String(key(2 * (int)i).c_str())) d.remove(d.key(i));
+    }
+    // every even key was at position i when it was read, so every one is gone
+    ASSERT_EQ(d.count(), 50u);
+    for (int i = 0; i < 50; i++) EXPECT_STREQ(d.key(i).c_str(), key(2 * i + 1).c_str());
+}
+
+TEST_F(DictionaryOrdered, DestroyAndReuse) {
+    Dictionary d;
+    for (int i = 0; i < 30; i++) d.insert(key(i).c_str(), val(i).c_str());
+    d.destroy();
+    EXPECT_EQ(d.count(), 0u);
+    d("x", "1"); d("y", "2");
+    EXPECT_STREQ(d.json().c_str(), "{\"x\":\"1\",\"y\":\"2\"}");
+}
+#endif
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,175 @@
+// test-dictionary-prefix.cpp - forEachPrefix() on every engine, plus adaptive
+// radix tree specifics: keys that are prefixes of other keys, inner nodes
+// growing through all four sizes, and removal down to an empty tree.
+// Default configuration (also rebuilt under _DICT_ENGINE_ART and others).
+#include <gtest/gtest.h>
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+class DictionaryPrefix : public ::testing::Test {};
+
+typedef std::vector<std::pair<std::string, std::string> > Pairs;
+
+static void collect(const String& key, const String& value, void* ctx) {
+    ((Pairs*)ctx)->push_back(std::make_pair(std::string(key.c_str()), std::string(value.c_str())));
+}
+
+static std::map<std::string, std::string> asMap(const Pairs& p) {
+    return std::map<std::string, std::string>(p.begin(), p.end());
+}
+
+static void loadConfig(Dictionary& d) {
+    d("mqtt.broker.host", "broker.lan");
+    d("mqtt.broker.port", "1883");
+    d("mqtt.user", "dev");
+    d("mqtt", "on");
+    d("mqttx", "other");
+    d("wifi.ssid", "home");
+    d("wifi.pass", "secret");
+    d("ota", "off");
+}
+
+TEST_F(DictionaryPrefix, SectionByPrefix) {
+    Dictionary d;
+    loadConfig(d);
+    Pairs p;
+    EXPECT_EQ(d.forEachPrefix("mqtt.", collect, &p), 3u);
+    std::map<std::string, std::string> m = asMap(p);
+    EXPECT_EQ(m.size(), 3u);
+    EXPECT_EQ(m["mqtt.broker.host"], "broker.lan");
+    EXPECT_EQ(m["mqtt.broker.port"], "1883");
+    EXPECT_EQ(m["mqtt.user"], "dev");
+}
+
+TEST_F(DictionaryPrefix, KeyEqualToPrefixIsIncluded) {
+    Dictionary d;
+    loadConfig(d);
+    Pairs p;
+    EXPECT_EQ(d.forEachPrefix(String("mqtt"), collect, &p), 5u);
+    EXPECT_EQ(asMap(p).count("mqtt"), 1u);
+    EXPECT_EQ(asMap(p).count("mqttx"), 1u);
+
+    p.clear();
+    EXPECT_EQ(d.forEachPrefix("mqtt.broker.port", collect, &p), 1u);
+    EXPECT_EQ(p[0].second, "1883");
+}
+
+TEST_F(DictionaryPrefix, NoMatchAndEmptyPrefix) {
+    Dictionary d;
+    Pairs p;
+    EXPECT_EQ(d.forEachPrefix("x", collect, &p), 0u);   // empty dictionary
+    loadConfig(d);
+    EXPECT_EQ(d.forEachPrefix("mqtt.broker.hostname", collect, &p), 0u);
+    EXPECT_EQ(d.forEachPrefix("mqtt.z", collect, &p), 0u);
+    EXPECT_EQ(d.forEachPrefix("zzz", collect, &p), 0u);
+    EXPECT_TRUE(p.empty());
+    EXPECT_EQ(d.forEachPrefix("", collect, &p), d.count());
+}
+
+TEST_F(DictionaryPrefix, WorksOnFrozenDictionary) {
+    Dictionary d;
+    loadConfig(d);
+    ASSERT_EQ(d.freeze(), DICTIONARY_OK);
+    Pairs p;
+    EXPECT_EQ(d.forEachPrefix("wifi.", collect, &p), 2u);
+    EXPECT_EQ(asMap(p)["wifi.pass"], "secret");
+}
+
+#ifdef _DICT_ENGINE_ART
+// The radix tree walks children in byte order, so results come out sorted.
+TEST_F(DictionaryPrefix, ArtVisitsInKeyOrder) {
+    Dictionary d;
+    loadConfig(d);
+    Pairs p;
+    d.forEachPrefix("", collect, &p);
+    ASSERT_EQ(p.size(), d.count());
+    for (size_t i = 1; i < p.size(); i++) EXPECT_LT(p[i - 1].first, p[i].first);
+}
+#endif
+
+// One inner node fanning out to 256 children (4 -> 16 -> 48 -> 256), keys that
+// end inside the tree, then everything removed again in a different order.
+TEST_F(DictionaryPrefix, FanOutAndRemoveAll) {
+    Dictionary d;
+    std::map<std::string, std::string> ref;
+    for (int c = 1; c < 256; c++) {
+        std::string k = std::string("p.") + (char)c;
+        std::string k2 = k + ".sub";
+        std::string v = std::to_string(c);
+        ASSERT_EQ(d.insert(k.c_str(), v.c_str()), DICTIONARY_OK);
+        ASSERT_EQ(d.insert(k2.c_str(), (v + "s").c_str()), DICTIONARY_OK);
+        ref[k] = v;
+        ref[k2] = v + "s";
+    }
+    ASSERT_EQ(d("p", "root"), DICTIONARY_OK);
+    ref["p"] = "root";
+
+    for (auto& kv : ref) EXPECT_STREQ(d[kv.first.c_str()].c_str(), kv.second.c_str());
+    Pairs p;
+    EXPECT_EQ(d.forEachPrefix("p.", collect, &p), ref.size() - 1);
+    EXPECT_EQ(asMap(p).size(), ref.size() - 1);
+
+    // remove every other key first, then the rest
+    int i = 0;
+    for (auto& kv : ref) {
+        if (i++ % 2) {
+            ASSERT_EQ(d.remove(kv.first.c_str()), DICTIONARY_OK);
+        }
+    }
+    i = 0;
+    for (auto& kv : ref) {
+        const char* expected = (i++ % 2) ? "" : kv.second.c_str();
+        EXPECT_STREQ(d[kv.first.c_str()].c_str(), expected);
+    }
+    for (auto& kv : ref) d.remove(kv.first.c_str());
+    EXPECT_EQ(d.count(), 0u);
+    p.clear();
+    EXPECT_EQ(d.forEachPrefix("", collect, &p), 0u);
+
+    ASSERT_EQ(d("p.a", "again"), DICTIONARY_OK);   // reusable after emptying
+    EXPECT_STREQ(d["p.a"].c_str(), "again");
+}
+
+// Random keys over a three-letter alphabet share long prefixes and are often
+// prefixes of each other. After every round of inserts and removes, each prefix
+// must visit exactly the keys a linear key(i) scan finds.
+TEST_F(DictionaryPrefix, MatchesLinearScan) {
+    Dictionary d;
+    std::mt19937 rng(7);
+    auto word = [&](size_t maxLen) {
+        std::string w(1 + rng() % maxLen, 'a');
+        for (char& c : w) c = "ab."[rng() % 3];
+        return w;
+    };
+
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 40; i++) {
+            std::string k = word(8);
+            ASSERT_EQ(d.insert(k.c_str(), (k + "=v").c_str()), DICTIONARY_OK);
+        }
+        for (int i = 0; i < 15; i++) d.remove(word(8).c_str());
+
+        for (int q = 0; q < 30; q++) {
+            std::string prefix = q ? word(4) : "";
+            std::map<std::string, std::string> scan;
+            for (size_t i = 0; i < d.count(); i++) {
+                std::string k = d.key(i).c_str();
+                if (k.compare(0, prefix.size(), prefix) == 0) scan[k] = d.value(i).c_str();
+            }
+            Pairs p;
+            EXPECT_EQ(d.forEachPrefix(prefix.c_str(), collect, &p), scan.size()) << "prefix=" << prefix;
+            EXPECT_EQ(p.size(), scan.size()) << "prefix=" << prefix;
+            EXPECT_EQ(asMap(p), scan) << "prefix=" << prefix;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,144 @@
+// test-dictionary-static.cpp - StaticDictionary: tables hashed by the compiler.
+// Lookups are checked both at compile time (static_assert on the constexpr
+// find()) and at run time, and the String surface is compared against a regular
+// Dictionary holding the same pairs.
+#include <gtest/gtest.h>
+#include "Arduino.h"
+#include "Dictionary.h"
+#include "StaticDictionary.h"
+
+#include <string>
+
+class StaticDict : public ::testing::Test {};
+
+static constexpr auto kDefaults = makeStaticDictionary({
+    { "ssid",        "home" },
+    { "mqtt.host",   "broker.lan" },
+    { "mqtt.port",   "1883" },
+    { "quote\"d",    "back\\slash" },
+    { "empty",       "" },
+});
+
+// 64 keys sharing long prefixes, so several land in the same probe runs.
+static constexpr auto kMany = makeStaticDictionary({
+    { "cfg.section0.key0", "0" },
+    { "cfg.section1.key1", "7" },
+    { "cfg.section2.key2", "14" },
+    { "cfg.section3.key3", "21" },
+    { "cfg.section4.key4", "28" },
+    { "cfg.section0.key5", "35" },
+    { "cfg.section1.key6", "42" },
+    { "cfg.section2.key7", "49" },
+    { "cfg.section3.key8", "56" },
+    { "cfg.section4.key9", "63" },
+    { "cfg.section0.key10", "70" },
+    { "cfg.section1.key11", "77" },
+    { "cfg.section2.key12", "84" },
+    { "cfg.section3.key13", "91" },
+    { "cfg.section4.key14", "98" },
+    { "cfg.section0.key15", "105" },
+    { "cfg.section1.key16", "112" },
+    { "cfg.section2.key17", "119" },
+    { "cfg.section3.key18", "126" },
+    { "cfg.section4.key19", "133" },
+    { "cfg.section0.key20", "140" },
+    { "cfg.section1.key21", "147" },
+    { "cfg.section2.key22", "154" },
+    { "cfg.section3.key23", "161" },
+    { "cfg.section4.key24", "168" },
+    { "cfg.section0.key25", "175" },
+    { "cfg.section1.key26", "182" },
+    { "cfg.section2.key27", "189" },
+    { "cfg.section3.key28", "196" },
+    { "cfg.section4.key29", "203" },
+    { "cfg.section0.key30", "210" },
+    { "cfg.section1.key31", "217" },
+    { "cfg.section2.key32", "224" },
+    { "cfg.section3.key33", "231" },
+    { "cfg.section4.key34", "238" },
+    { "cfg.section0.key35", "245" },
+    { "cfg.section1.key36", "252" },
+    { "cfg.section2.key37", "259" },
+    { "cfg.section3.key38", "266" },
+    { "cfg.section4.key39", "273" },
+    { "cfg.section0.key40", "280" },
+    { "cfg.section1.key41", "287" },
+    { "cfg.section2.key42", "294" },
+    { "cfg.section3.key43", "301" },
+    { "cfg.section4.key44", "308" },
+    { "cfg.section0.key45", "315" },
+    { "cfg.section1.key46", "322" },
+    { "cfg.section2.key47", "329" },
+    { "cfg.section3.key48", "336" },
+    { "cfg.section4.key49", "343" },
+    { "cfg.section0.key50", "350" },
+    { "cfg.section1.key51", "357" },
+    { "cfg.section2.key52", "364" },
+    { "cfg.section3.key53", "371" },
+    { "cfg.section4.key54", "378" },
+    { "cfg.section0.key55", "385" },
+    { "cfg.section1.key56", "392" },
+    { "cfg.section2.key57", "399" },
+    { "cfg.section3.key58", "406" },
+    { "cfg.section4.key59", "413" },
+    { "cfg.section0.key60", "420" },
+    { "cfg.section1.key61", "427" },
+    { "cfg.section2.key62", "434" },
+    { "cfg.section3.key63", "441" },
+});
+
+static_assert(kDefaults.count() == 5, "count is known at compile time");
+static_assert(kDefaults.find("mqtt.port") == 2, "lookups work at compile time");
+static_assert(kDefaults.find("mqtt") == kDefaults.count(), "missing key");
+static_assert(kMany.find("cfg.section3.key63") == 63, "last of many");
+
+TEST_F(StaticDict, SearchAndExists) {
+    EXPECT_STREQ(kDefaults["ssid"].c_str(), "home");
+    EXPECT_STREQ(kDefaults.search("mqtt.host").c_str(), "broker.lan");
+    EXPECT_STREQ(kDefaults.search(String("mqtt.port")).c_str(), "1883");
+    EXPECT_STREQ(kDefaults["nope"].c_str(), "");
+    EXPECT_STREQ(kDefaults["mqtt.por"].c_str(), "");
+    EXPECT_TRUE(kDefaults(String("empty")));
+    EXPECT_FALSE(kDefaults(String("")));
+    EXPECT_FALSE(kDefaults(String("mqtt.port.x")));
+}
+
+TEST_F(StaticDict, PositionalAccessInDeclarationOrder) {
+    EXPECT_STREQ(kDefaults(0).c_str(), "ssid");
+    EXPECT_STREQ(kDefaults.key(3).c_str(), "quote\"d");
+    EXPECT_STREQ(kDefaults[(size_t)1].c_str(), "broker.lan");
+    EXPECT_STREQ(kDefaults.value(4).c_str(), "");
+    EXPECT_STREQ(kDefaults.key(5).c_str(), "");      // out of range
+    EXPECT_STREQ(kDefaults.value(99).c_str(), "");
+}
+
+TEST_F(StaticDict, ManyKeysAllFound) {
+    for (size_t i = 0; i < kMany.count(); i++) {
+        String k = kMany.key(i);
+        EXPECT_EQ(kMany.find(k.c_str()), i);
+        EXPECT_STREQ(kMany[k].c_str(), std::to_string(i * 7).c_str());
+    }
+    EXPECT_STREQ(kMany["cfg.section0.key64"].c_str(), "");
+}
+
+// json()/jsize()/esize() match a Dictionary loaded with the same pairs, and the
+// JSON loads back into one.
+TEST_F(StaticDict, JsonMatchesDictionary) {
+    Dictionary d;
+    for (size_t i = 0; i < kDefaults.count(); i++)
+        ASSERT_EQ(d.insert(kDefaults.key(i), kDefaults.value(i)), DICTIONARY_OK);
+
+    EXPECT_STREQ(kDefaults.json().c_str(), d.json().c_str());
+    EXPECT_EQ(kDefaults.jsize(), d.jsize());
+    EXPECT_EQ(kDefaults.esize(), d.esize());
+
+    Dictionary e;
+    ASSERT_EQ(e.jload(kMany.json()), DICTIONARY_OK);
+    EXPECT_EQ(e.count(), kMany.count());
+    EXPECT_STREQ(e["cfg.section2.key17"].c_str(), "119");
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
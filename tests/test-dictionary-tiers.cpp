@@ -0,0 +1,209 @@
+// test-dictionary-tiers.cpp - hot/cold value tiers (_DICT_TIERS, rebalanceTiers()).
+//
+// Two simulated memory regions behind Dictionary::setAllocator(): "dram" holds
+// everything but cold values (DICT_MEM_HOT included), "psram" holds DICT_MEM_VALUE.
+// The tests find which region holds each key's value by its bytes, and charge
+// every lookup the latency of that region to compare access costs before and
+// after a rebalance.
+#include <gtest/gtest.h>
+#include "Arduino.h"
+#include "Dictionary.h"
+
+#include <cstring>
+#include <map>
+#include <string>
+
+namespace {
+
+struct Block { uint8_t region; size_t size; };
+
+struct Heap {
+    std::map<void*, Block> live;
+
+    size_t count(uint8_t region) const {
+        size_t c = 0;
+        for (const auto& b : live) c += (b.second.region == region);
+        return c;
+    }
+    size_t bytes(uint8_t region) const {
+        size_t c = 0;
+        for (const auto& b : live) c += (b.second.region == region) ? b.second.size : 0;
+        return c;
+    }
+    bool holds(const std::string& s) const {
+        for (const auto& b : live)
+            if (b.second.size == s.size() + 1 && memcmp(b.first, s.c_str(), s.size() + 1) == 0) return true;
+        return false;
+    }
+};
+
+Heap    g_dram, g_psram;
+long    g_badFrees = 0;
+uint8_t g_failRegions = 0;              // allocations for these regions fail
+
+Heap& heapOf(uint8_t region) { return region == DICT_MEM_VALUE ? g_psram : g_dram; }
+
+void* tierAlloc(size_t size, uint8_t region) {
+    Heap& h = heapOf(region);
+    if (region & g_failRegions) return NULL;
+    void* p = malloc(size);
+    if (p) h.live[p] = Block{ region, size };
+    return p;
+}
+
+void tierFree(void* p, uint8_t region) {
+    Heap& h = heapOf(region);
+    auto it = h.live.find(p);
+    if (it == h.live.end() || it->second.region != region) g_badFrees++;
+    else h.live.erase(it);
+    free(p);
+}
+
+const DictionaryAllocator tiers = { tierAlloc, tierFree };
+
+// Latency model: reading a value costs 1 from internal RAM, 8 from PSRAM.
+const long DRAM_COST = 1, PSRAM_COST = 8;
+
+const int N = 200;
+std::string key(int i) { return "sensor/" + std::to_string(i) + "/reading"; }
+std::string val(int i) {
+    std::string v = "reading " + std::to_string(i) + " ";
+    return v + std::string(31 - v.size(), '.');     // 31 characters + NUL = 32 bytes
+}
+const size_t VALUE_BYTES = 32;
+
+// Searches keys [from, from + 10) 200 times each, round-robin; returns the modeled cost.
+long readHot(Dictionary& d, int from) {
+    long cost = 0;
+    for (int r = 0; r < 200; r++) {
+        for (int i = from; i < from + 10; i++) {
+            EXPECT_STREQ(d.search(key(i).c_str()).c_str(), val(i).c_str());
+            cost += g_dram.holds(val(i)) ? DRAM_COST : PSRAM_COST;
+        }
+    }
+    return cost;
+}
+
+}  // namespace
+
+class DictionaryTiers : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        g_dram = Heap();
+        g_psram = Heap();
+        g_badFrees = 0;
+        g_failRegions = 0;
+        Dictionary::setAllocator(&tiers);
+        d = new Dictionary;
+        for (int i = 0; i < N; i++) ASSERT_EQ(d->insert(key(i).c_str(), val(i).c_str()), DICTIONARY_OK);
+        for (int i = 0; i < N; i++) d->search(key(i).c_str());      // every key read once
+    }
+    void TearDown() override {
+        delete d;
+        EXPECT_TRUE(g_dram.live.empty());
+        EXPECT_TRUE(g_psram.live.empty());
+        EXPECT_EQ(g_badFrees, 0);
+        Dictionary::setAllocator(NULL);
+    }
+    Dictionary* d;
+};
+
+// The ten hottest values fill a ten-value budget; lookups of them get cheaper.
+TEST_F(DictionaryTiers, HottestValuesMoveIntoTheBudget) {
+    EXPECT_EQ(g_psram.count(DICT_MEM_VALUE), (size_t)N);
+    long before = readHot(*d, 0);
+    EXPECT_EQ(before, 2000 * PSRAM_COST);
+
+    ASSERT_EQ(d->rebalanceTiers(10 * VALUE_BYTES), DICTIONARY_OK);
+    EXPECT_EQ(g_dram.count(DICT_MEM_HOT), 10u);
+    EXPECT_LE(g_dram.bytes(DICT_MEM_HOT), 10 * VALUE_BYTES);
+    EXPECT_EQ(g_psram.count(DICT_MEM_VALUE), (size_t)(N - 10));
+    for (int i = 0; i < 10; i++) EXPECT_TRUE(g_dram.holds(val(i))) << key(i);
+
+    long after = readHot(*d, 0);
+    EXPECT_EQ(after, 2000 * DRAM_COST);
+    for (int i = 0; i < N; i++) EXPECT_STREQ(d->search(key(i).c_str()).c_str(), val(i).c_str());
+}
+
+// When the working set changes, the new hot values replace the old ones.
+TEST_F(DictionaryTiers, ColdValuesAreDemoted) {
+    readHot(*d, 0);
+    ASSERT_EQ(d->rebalanceTiers(10 * VALUE_BYTES), DICTIONARY_OK);
+    readHot(*d, 100);
+    ASSERT_EQ(d->rebalanceTiers(10 * VALUE_BYTES), DICTIONARY_OK);
+
+    EXPECT_EQ(g_dram.count(DICT_MEM_HOT), 10u);
+    for (int i = 0; i < 10; i++) EXPECT_TRUE(g_psram.holds(val(i))) << key(i);
+    for (int i = 100; i < 110; i++) EXPECT_TRUE(g_dram.holds(val(i))) << key(i);
+
+    // No budget: everything goes back.
+    ASSERT_EQ(d->rebalanceTiers(0), DICTIONARY_OK);
+    EXPECT_EQ(g_dram.count(DICT_MEM_HOT), 0u);
+    EXPECT_EQ(g_psram.count(DICT_MEM_VALUE), (size_t)N);
+}
+
+// A budget too small for a whole hit count is filled with part of it; entries
+// never searched since the last rebalance stay cold whatever the budget.
+TEST_F(DictionaryTiers, BudgetIsNeverExceeded) {
+    readHot(*d, 0);
+    ASSERT_EQ(d->rebalanceTiers(3 * VALUE_BYTES + 5), DICTIONARY_OK);
+    EXPECT_EQ(g_dram.count(DICT_MEM_HOT), 3u);
+
+    ASSERT_EQ(d->rebalanceTiers(0), DICTIONARY_OK);
+    for (int i = 0; i < 8; i++) ASSERT_EQ(d->rebalanceTiers(0), DICTIONARY_OK);   // age every count to 0
+    for (int i = 0; i < 8; i++) d->search(key(5).c_str());
+    ASSERT_EQ(d->rebalanceTiers(N * VALUE_BYTES), DICTIONARY_OK);
+    EXPECT_LE(g_dram.count(DICT_MEM_HOT), 1u);
+    EXPECT_GE(g_psram.count(DICT_MEM_VALUE), (size_t)(N - 1));
+}
+
+// A hot value keeps its tier when it is updated; removes and destroy() free it
+// from the right region.
+TEST_F(DictionaryTiers, UpdatesKeepTheTier) {
+    readHot(*d, 0);
+    ASSERT_EQ(d->rebalanceTiers(10 * VALUE_BYTES), DICTIONARY_OK);
+
+    std::string longer = val(3) + val(3);
+    ASSERT_EQ(d->insert(key(3).c_str(), longer.c_str()), DICTIONARY_OK);
+    EXPECT_TRUE(g_dram.holds(longer));
+    EXPECT_STREQ(d->search(key(3).c_str()).c_str(), longer.c_str());
+
+    for (int i = 0; i < N; i += 2) ASSERT_EQ(d->remove(key(i).c_str()), DICTIONARY_OK);
+    EXPECT_EQ(g_dram.count(DICT_MEM_HOT), 5u);
+    EXPECT_EQ(g_psram.count(DICT_MEM_VALUE), (size_t)(N / 2 - 5));
+    for (int i = 1; i < N; i += 2)
+        EXPECT_STREQ(d->search(key(i).c_str()).c_str(), i == 3 ? longer.c_str() : val(i).c_str());
+
+    d->destroy();
+    EXPECT_EQ(g_dram.count(DICT_MEM_HOT), 0u);
+    EXPECT_EQ(g_psram.count(DICT_MEM_VALUE), 0u);
+}
+
+// A move that cannot allocate leaves the value where it was.
+TEST_F(DictionaryTiers, FailedMovesLeaveValuesReadable) {
+    readHot(*d, 0);
+    g_failRegions = DICT_MEM_HOT;
+    EXPECT_EQ(d->rebalanceTiers(10 * VALUE_BYTES), DICTIONARY_MEM);
+    g_failRegions = 0;
+    EXPECT_EQ(g_psram.count(DICT_MEM_VALUE), (size_t)N);
+
+    readHot(*d, 0);
+    ASSERT_EQ(d->rebalanceTiers(10 * VALUE_BYTES), DICTIONARY_OK);
+    g_failRegions = DICT_MEM_VALUE;
+    EXPECT_EQ(d->rebalanceTiers(0), DICTIONARY_MEM);
+    g_failRegions = 0;
+    EXPECT_EQ(g_dram.count(DICT_MEM_HOT), 10u);
+    for (int i = 0; i < N; i++) EXPECT_STREQ(d->search(key(i).c_str()).c_str(), val(i).c_str());
+}
+
+TEST_F(DictionaryTiers, FrozenDictionaryIsNotRebalanced) {
+    readHot(*d, 0);
+    ASSERT_EQ(d->freeze(), DICTIONARY_OK);
+    EXPECT_EQ(d->rebalanceTiers(10 * VALUE_BYTES), DICTIONARY_ERR);
+    EXPECT_STREQ(d->search(key(0).c_str()).c_str(), val(0).c_str());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}